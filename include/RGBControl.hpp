@@ -1,34 +1,55 @@
 #ifndef RGBCONTROL_H
 #define RGBCONTROL_H
 #include <Arduino.h>
+#include "board.hpp"
+#include "color.hpp"
 
-struct RGB
+enum FadePath
 {
-    int red;
-    int green;
-    int blue;
+    FADE_LINEAR,
+    FADE_HSV
 };
 
-bool operator==(const RGB &lhs, const RGB &rhs)
-{
-    return lhs.red == rhs.red && lhs.green == rhs.green && lhs.blue == rhs.blue;
-}
-
+template <class Board>
 class RGBControl
 {
 public:
-    RGBControl(uint8_t redPin, uint8_t greenPin, uint8_t bluePin) : _redPin(redPin), _greenPin(greenPin), _bluePin(bluePin), fadeSpeed(3), color({0, 0, 0}), targetColor({0, 0, 0}), nextUpdate(0)
+    RGBControl(uint8_t redPin, uint8_t greenPin, uint8_t bluePin, const Calibration &calibration = CALIBRATION_NONE)
+        : _redPin(redPin), _greenPin(greenPin), _bluePin(bluePin), fadeSpeed(3), fadePath(FADE_HSV), color({0, 0, 0}), targetColor({0, 0, 0}), requestedColor({0, 0, 0}),
+          hsv({0, 0, 0}), targetHsv({0, 0, 0}), calibration(calibration), nextUpdate(0)
     {
-        pinMode(redPin, OUTPUT);
-        pinMode(greenPin, OUTPUT);
-        pinMode(bluePin, OUTPUT);
+        Board::outputPin(redPin);
+        Board::outputPin(greenPin);
+        Board::outputPin(bluePin);
 
         applyColor();
     }
 
+    void setFadePath(FadePath path)
+    {
+        fadePath = path;
+        hsv = rgbToHsv(color);
+        requestedColor = targetColor;
+    }
+
     void fadeTo(RGB _targetColor, short speed)
     {
         fadeSpeed = speed;
+        if (fadePath == FADE_HSV)
+        {
+            // Only convert when the target changes, the state machine calls this every tick
+            if (!(_targetColor == requestedColor))
+            {
+                requestedColor = _targetColor;
+                startHsvFade(rgbToHsv(_targetColor));
+            }
+            else if (fadeSpeed <= 0)
+            {
+                hsv = targetHsv;
+                color = targetColor;
+            }
+            return;
+        }
         targetColor = _targetColor;
         if (fadeSpeed <= 0)
         {
@@ -36,14 +57,29 @@ public:
         }
     }
 
+    void fadeTo(HSV _targetHsv, short speed)
+    {
+        fadeSpeed = speed;
+        fadePath = FADE_HSV;
+        requestedColor = {0xffff, 0xffff, 0xffff};
+        startHsvFade(_targetHsv);
+    }
+
     void loop()
     {
         unsigned long time = millis();
         if (time >= nextUpdate)
         {
-            color.red = constrain(targetColor.red, color.red - fadeSpeed, color.red + fadeSpeed);
-            color.green = constrain(targetColor.green, color.green - fadeSpeed, color.green + fadeSpeed);
-            color.blue = constrain(targetColor.blue, color.blue - fadeSpeed, color.blue + fadeSpeed);
+            if (fadePath == FADE_HSV)
+            {
+                stepHsv();
+            }
+            else
+            {
+                color.red = constrain(targetColor.red, color.red - fadeSpeed, color.red + fadeSpeed);
+                color.green = constrain(targetColor.green, color.green - fadeSpeed, color.green + fadeSpeed);
+                color.blue = constrain(targetColor.blue, color.blue - fadeSpeed, color.blue + fadeSpeed);
+            }
 
             applyColor();
             nextUpdate = max(time, nextUpdate + 20);
@@ -76,16 +112,67 @@ private:
     uint8_t _greenPin;
     uint8_t _bluePin;
     short fadeSpeed;
+    FadePath fadePath;
     RGB color;
     RGB targetColor;
+    RGB requestedColor;
+    HSV hsv;
+    HSV targetHsv;
+    Calibration calibration;
     unsigned long nextUpdate;
 
+    void startHsvFade(HSV _targetHsv)
+    {
+        targetHsv = _targetHsv;
+        // Hue and saturation are meaningless at either end of a fade from or to black or white
+        if (hsv.val == 0)
+        {
+            hsv.hue = targetHsv.hue;
+            hsv.sat = targetHsv.sat;
+        }
+        if (targetHsv.val == 0)
+        {
+            targetHsv.hue = hsv.hue;
+            targetHsv.sat = hsv.sat;
+        }
+        else if (targetHsv.sat == 0)
+        {
+            targetHsv.hue = hsv.hue;
+        }
+        targetColor = hsvToRgb(targetHsv);
+        if (fadeSpeed <= 0)
+        {
+            hsv = targetHsv;
+            color = targetColor;
+        }
+    }
+
+    void stepHsv()
+    {
+        // Walk the shorter way around the hue circle, at the same pace as a linear fade
+        int hueSpeed = fadeSpeed * 3 / 2;
+        int hueDelta = targetHsv.hue - hsv.hue;
+        if (hueDelta > HUE_RANGE / 2)
+            hueDelta -= HUE_RANGE;
+        else if (hueDelta < -HUE_RANGE / 2)
+            hueDelta += HUE_RANGE;
+        hsv.hue += constrain(hueDelta, -hueSpeed, hueSpeed);
+        if (hsv.hue < 0)
+            hsv.hue += HUE_RANGE;
+        else if (hsv.hue >= HUE_RANGE)
+            hsv.hue -= HUE_RANGE;
+        hsv.sat = constrain(targetHsv.sat, hsv.sat - fadeSpeed, hsv.sat + fadeSpeed);
+        hsv.val = constrain(targetHsv.val, hsv.val - fadeSpeed, hsv.val + fadeSpeed);
+        color = hsv == targetHsv ? targetColor : hsvToRgb(hsv);
+    }
+
     void applyColor()
     {
-        analogWrite(_redPin, color.red);
-        analogWrite(_greenPin, color.green);
-        analogWrite(_bluePin, color.blue);
+        RGB duty = calibrate(calibration, color);
+        Board::writePwm(_redPin, rescale<COLOR_BITS, Board::PWM_BITS>(duty.red));
+        Board::writePwm(_greenPin, rescale<COLOR_BITS, Board::PWM_BITS>(duty.green));
+        Board::writePwm(_bluePin, rescale<COLOR_BITS, Board::PWM_BITS>(duty.blue));
     }
 };
 
-#endif
\ No newline at end of file
+#endif
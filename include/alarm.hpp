@@ -33,6 +33,18 @@ public:
 
     void stop() { active = false; }
 
+    // Seconds from time until the alarm next goes off, -1 if it never will
+    long secondsUntil(time_t time) const
+    {
+        if (!enabled || _dayOfWeek < 1 || _dayOfWeek > 7)
+            return -1;
+        long days = (_dayOfWeek - weekday(time) + 7) % 7;
+        long seconds = days * SECS_PER_DAY + getAlarmSecond() - (long)elapsedSecsToday(time);
+        if (seconds < 0)
+            seconds += SECS_PER_WEEK;
+        return seconds;
+    }
+
     void loop()
     {
         time_t time = now();
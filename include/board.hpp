@@ -0,0 +1,60 @@
+#ifndef BOARD_H
+#define BOARD_H
+#include <Arduino.h>
+
+// Rescales an unsigned value from FROM to TO bits. The shifts and the divisor fold at compile time.
+template <uint8_t FROM, uint8_t TO>
+uint32_t rescale(uint32_t value)
+{
+    if (FROM >= TO)
+        return value >> (FROM >= TO ? FROM - TO : 0);
+    return value * ((1UL << TO) - 1) / ((1UL << FROM) - 1);
+}
+
+// Hardware traits consumed by RGBControl and AnalogRead. A board provides:
+//   Channel           - smallest type holding a PWM duty
+//   PWM_BITS/ADC_BITS - output and input resolution
+//   writePwm/readAdc  - the raw hardware access
+//   pin constants     - the wiring used by main.cpp
+struct Esp8266Board
+{
+    typedef uint16_t Channel;
+    static const uint8_t PWM_BITS = 10;
+    static const uint8_t ADC_BITS = 10;
+
+    static const uint8_t RED = D2;
+    static const uint8_t GREEN = D5;
+    static const uint8_t BLUE = D1;
+    // Zone 2 has to share boot strapping pins: GPIO4/5/12/13/14 are taken above, GPIO16 has no PWM
+    // and TX must stay high at boot. The MOSFET gates therefore need fixed levels while the chip boots:
+    //   D3 (GPIO0)  - must be high or the ESP enters the flash loader: 10k pull-up to 3V3. The red
+    //                 channel of zone 2 is fully on for the ~100 ms until setup() takes the pin.
+    //   D8 (GPIO15) - must be low or the ESP boots from SD: 10k pull-down to GND (the usual gate
+    //                 pull-down, NodeMCU boards already fit one).
+    //   RX (GPIO3)  - no strapping function, serial is not used.
+    static const uint8_t RED2 = D3;
+    static const uint8_t GREEN2 = D8;
+    static const uint8_t BLUE2 = 3;
+    static const uint8_t MOTION1 = D6;
+    static const uint8_t MOTION2 = D7;
+    static const uint8_t LIGHT_SENSOR = A0;
+
+    static void outputPin(uint8_t pin) { pinMode(pin, OUTPUT); }
+    static void writePwm(uint8_t pin, Channel duty) { analogWrite(pin, duty); }
+    static int readAdc(uint8_t pin) { return analogRead(pin); }
+};
+
+// Same wiring driven at 16 bit PWM resolution (core 3.0+). Gives the low end of a fade finer steps.
+struct Esp8266Pwm16Board : Esp8266Board
+{
+    typedef uint16_t Channel;
+    static const uint8_t PWM_BITS = 16;
+
+    static void outputPin(uint8_t pin)
+    {
+        pinMode(pin, OUTPUT);
+        analogWriteResolution(PWM_BITS);
+    }
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef BOOTCACHE_H
+#define BOOTCACHE_H
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+// Everything needed to rejoin the last access point without scanning or DHCP
+struct WifiCache
+{
+    int32_t channel;
+    uint8_t bssid[6];
+    uint8_t reserved[2];
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+
+    bool isValid() const { return channel > 0 && ip != 0; }
+
+    bool operator==(const WifiCache &other) const
+    {
+        return channel == other.channel && !memcmp(bssid, other.bssid, sizeof(bssid)) && ip == other.ip &&
+               gateway == other.gateway && subnet == other.subnet && dns == other.dns;
+    }
+
+    static WifiCache current()
+    {
+        WifiCache cache;
+        memset(&cache, 0, sizeof(cache));
+        cache.channel = WiFi.channel();
+        memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+        cache.ip = WiFi.localIP();
+        cache.gateway = WiFi.gatewayIP();
+        cache.subnet = WiFi.subnetMask();
+        cache.dns = WiFi.dnsIP();
+        return cache;
+    }
+};
+
+// Survives resets and deep sleep, but not a power loss
+class RtcCache
+{
+public:
+    WifiCache wifi;
+    uint32_t epoch;
+
+    RtcCache() : epoch(0) { memset(&wifi, 0, sizeof(wifi)); }
+
+    bool load()
+    {
+        Stored stored;
+        if (!ESP.rtcUserMemoryRead(0, (uint32_t *)&stored, sizeof(stored)) || stored.crc != crc32(stored))
+            return false;
+        wifi = stored.wifi;
+        epoch = stored.epoch;
+        return true;
+    }
+
+    void save()
+    {
+        Stored stored;
+        memset(&stored, 0, sizeof(stored));
+        stored.wifi = wifi;
+        stored.epoch = epoch;
+        stored.crc = crc32(stored);
+        ESP.rtcUserMemoryWrite(0, (uint32_t *)&stored, sizeof(stored));
+    }
+
+private:
+    struct Stored
+    {
+        uint32_t crc;
+        WifiCache wifi;
+        uint32_t epoch;
+    } __attribute__((aligned(4)));
+
+    static uint32_t crc32(const Stored &stored)
+    {
+        const uint8_t *data = (const uint8_t *)&stored + sizeof(stored.crc);
+        size_t length = sizeof(stored) - sizeof(stored.crc);
+        uint32_t crc = 0xffffffff;
+        while (length--)
+        {
+            crc ^= *data++;
+            for (int i = 0; i < 8; i++)
+                crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+        return ~crc;
+    }
+};
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef COLOR_H
+#define COLOR_H
+#include <Arduino.h>
+
+// Linear duty per channel, 0..1023. RGBControl rescales it to the board's PWM resolution.
+static const uint8_t COLOR_BITS = 10;
+
+struct RGB
+{
+    uint16_t red;
+    uint16_t green;
+    uint16_t blue;
+};
+
+inline bool operator==(const RGB &lhs, const RGB &rhs)
+{
+    return lhs.red == rhs.red && lhs.green == rhs.green && lhs.blue == rhs.blue;
+}
+
+// hue: 0..1535 (256 steps per sector), sat: 0..1023, val: perceptual lightness 0..1023
+struct HSV
+{
+    int hue;
+    int sat;
+    int val;
+};
+
+inline bool operator==(const HSV &lhs, const HSV &rhs)
+{
+    return lhs.hue == rhs.hue && lhs.sat == rhs.sat && lhs.val == rhs.val;
+}
+
+static const int HUE_RANGE = 6 * 256;
+
+// 3x3 matrix mapping requested RGB to PWM duty, Q10 (1024 = 1.0).
+// Rows are the output channels, columns the requested channels.
+struct Calibration
+{
+    int16_t m[3][3];
+};
+
+static const Calibration CALIBRATION_NONE = {{{1024, 0, 0}, {0, 1024, 0}, {0, 0, 1024}}};
+
+// CIE 1931 lightness to linear duty, indexed by lightness >> 2
+static const uint16_t LIGHTNESS_TO_DUTY[256] PROGMEM = {
+    0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 4, 5, 5, 6, 6, 7,
+    7, 8, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 15,
+    15, 16, 17, 17, 18, 19, 19, 20, 21, 22, 22, 23, 24, 25, 26, 27,
+    28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 42, 43, 44,
+    45, 47, 48, 50, 51, 52, 54, 55, 57, 58, 60, 61, 63, 65, 66, 68,
+    70, 71, 73, 75, 77, 79, 81, 83, 84, 86, 88, 90, 93, 95, 97, 99,
+    101, 103, 106, 108, 110, 113, 115, 118, 120, 123, 125, 128, 130, 133, 136, 138,
+    141, 144, 147, 149, 152, 155, 158, 161, 164, 167, 171, 174, 177, 180, 183, 187,
+    190, 194, 197, 200, 204, 208, 211, 215, 218, 222, 226, 230, 234, 237, 241, 245,
+    249, 254, 258, 262, 266, 270, 275, 279, 283, 288, 292, 297, 301, 306, 311, 315,
+    320, 325, 330, 335, 340, 345, 350, 355, 360, 365, 370, 376, 381, 386, 392, 397,
+    403, 408, 414, 420, 425, 431, 437, 443, 449, 455, 461, 467, 473, 480, 486, 492,
+    499, 505, 512, 518, 525, 532, 538, 545, 552, 559, 566, 573, 580, 587, 594, 601,
+    609, 616, 624, 631, 639, 646, 654, 662, 669, 677, 685, 693, 701, 709, 717, 726,
+    734, 742, 751, 759, 768, 776, 785, 794, 802, 811, 820, 829, 838, 847, 857, 866,
+    875, 885, 894, 903, 913, 923, 932, 942, 952, 962, 972, 982, 992, 1002, 1013, 1023,
+};
+
+// Black body color from 1000K to 10000K in 500K steps, 8 bit per channel
+static const uint8_t KELVIN_TO_RGB[19][3] PROGMEM = {
+    {255, 56, 0}, {255, 109, 0}, {255, 137, 18}, {255, 161, 72}, {255, 180, 107},
+    {255, 196, 137}, {255, 209, 163}, {255, 219, 186}, {255, 228, 206}, {255, 236, 224},
+    {255, 243, 239}, {255, 249, 253}, {245, 243, 255}, {235, 238, 255}, {227, 233, 255},
+    {220, 229, 255}, {214, 225, 255}, {208, 222, 255}, {204, 219, 255}};
+
+inline int lightnessToDuty(int val)
+{
+    val = constrain(val, 0, 1023);
+    int i = val >> 2;
+    int low = pgm_read_word(&LIGHTNESS_TO_DUTY[i]);
+    if (i == 255)
+        return low;
+    int high = pgm_read_word(&LIGHTNESS_TO_DUTY[i + 1]);
+    return low + (((high - low) * (val & 3)) >> 2);
+}
+
+inline int dutyToLightness(int duty)
+{
+    if (duty <= 0)
+        return 0;
+    int low = 0;
+    int high = 255;
+    while (low < high)
+    {
+        int mid = (low + high + 1) >> 1;
+        if ((int)pgm_read_word(&LIGHTNESS_TO_DUTY[mid]) <= duty)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+    if (low == 255)
+        return 1023;
+    int base = pgm_read_word(&LIGHTNESS_TO_DUTY[low]);
+    int step = pgm_read_word(&LIGHTNESS_TO_DUTY[low + 1]) - base;
+    return (low << 2) + (step ? (duty - base) * 4 / step : 0);
+}
+
+inline RGB hsvToRgb(const HSV &hsv)
+{
+    int hue = hsv.hue % HUE_RANGE;
+    if (hue < 0)
+        hue += HUE_RANGE;
+    uint32_t sat = constrain(hsv.sat, 0, 1023);
+    uint32_t s = sat + (sat >> 9);
+    uint32_t frac = hue & 0xff;
+    uint16_t v = lightnessToDuty(hsv.val);
+    uint16_t p = v * (1024 - s) >> 10;
+    uint16_t q = v * (1024 - (s * frac >> 8)) >> 10;
+    uint16_t t = v * (1024 - (s * (256 - frac) >> 8)) >> 10;
+    switch (hue >> 8)
+    {
+    case 0:
+        return {v, t, p};
+    case 1:
+        return {q, v, p};
+    case 2:
+        return {p, v, t};
+    case 3:
+        return {p, q, v};
+    case 4:
+        return {t, p, v};
+    default:
+        return {v, p, q};
+    }
+}
+
+inline HSV rgbToHsv(const RGB &rgb)
+{
+    int high = max(rgb.red, max(rgb.green, rgb.blue));
+    int low = min(rgb.red, min(rgb.green, rgb.blue));
+    int delta = high - low;
+    HSV hsv = {0, 0, dutyToLightness(high)};
+    if (delta == 0 || high == 0)
+        return hsv;
+    hsv.sat = (long)delta * 1023 / high;
+    if (high == rgb.red)
+        hsv.hue = 256L * (rgb.green - rgb.blue) / delta;
+    else if (high == rgb.green)
+        hsv.hue = 512 + 256L * (rgb.blue - rgb.red) / delta;
+    else
+        hsv.hue = 1024 + 256L * (rgb.red - rgb.green) / delta;
+    if (hsv.hue < 0)
+        hsv.hue += HUE_RANGE;
+    return hsv;
+}
+
+// Color of a black body at kelvin with the given perceptual lightness (0..1023)
+inline HSV kelvinToHsv(int kelvin, int val)
+{
+    kelvin = constrain(kelvin, 1000, 10000) - 1000;
+    int i = min(kelvin / 500, 17);
+    int frac = kelvin - i * 500;
+    uint16_t channel[3];
+    for (int c = 0; c < 3; c++)
+    {
+        int low = pgm_read_byte(&KELVIN_TO_RGB[i][c]);
+        int high = pgm_read_byte(&KELVIN_TO_RGB[i + 1][c]);
+        channel[c] = (low << 2) + ((high - low) * frac * 4 / 500);
+    }
+    HSV hsv = rgbToHsv({channel[0], channel[1], channel[2]});
+    hsv.val = val;
+    return hsv;
+}
+
+inline RGB calibrate(const Calibration &cal, const RGB &rgb)
+{
+    int in[3] = {rgb.red, rgb.green, rgb.blue};
+    uint16_t out[3];
+    for (int row = 0; row < 3; row++)
+    {
+        long sum = (long)cal.m[row][0] * in[0] + (long)cal.m[row][1] * in[1] + (long)cal.m[row][2] * in[2];
+        out[row] = constrain(sum >> 10, 0L, 1023L);
+    }
+    return {out[0], out[1], out[2]};
+}
+
+#endif
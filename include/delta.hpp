@@ -0,0 +1,285 @@
+#ifndef DELTA_H
+#define DELTA_H
+#include <Arduino.h>
+
+// Firmware delta against the running image, produced by tools/mkdelta.py.
+//
+// Header, then blocks until newSize bytes were produced:
+//   addLen, extraLen (uint32), seek (int32), little endian
+//   addLen bytes added to the old image at the current position, zero run coded:
+//     0x00 n stands for n + 1 zero bytes, any other byte for itself
+//   extraLen literal bytes
+// after which the old position moves by addLen + seek.
+struct DeltaHeader
+{
+    char magic[4];
+    uint32_t oldSize;
+    uint32_t newSize;
+    uint8_t oldMd5[16];
+    uint8_t newMd5[16];
+};
+
+static const size_t DELTA_HEADER_SIZE = 44;
+static const size_t DELTA_CONTROL_SIZE = 12;
+
+// Decodes a delta fed in arbitrary chunks, using fixed buffers only
+class DeltaDecoder
+{
+public:
+    // Reads len bytes of the old image at a 4 byte aligned offset, len is a multiple of 4
+    typedef bool (*ReadOld)(uint32_t offset, uint32_t *buf, size_t len);
+    typedef bool (*WriteNew)(const uint8_t *buf, size_t len);
+    typedef bool (*OnHeader)(const DeltaHeader &header);
+
+    DeltaDecoder(ReadOld readOld, WriteNew writeNew, OnHeader onHeader)
+        : readOld(readOld), writeNew(writeNew), onHeader(onHeader)
+    {
+        begin();
+    }
+
+    void begin()
+    {
+        state = HEADER;
+        pending = 0;
+        outLength = 0;
+        produced = 0;
+        oldPos = 0;
+        seek = 0;
+        windowStart = 0;
+        windowValid = false;
+        error = nullptr;
+    }
+
+    // Returns false once the delta turned out to be invalid, see getError()
+    bool write(const uint8_t *data, size_t length)
+    {
+        while (length && state != FAILED)
+        {
+            switch (state)
+            {
+            case HEADER:
+            case CONTROL:
+            {
+                size_t want = (state == HEADER ? DELTA_HEADER_SIZE : DELTA_CONTROL_SIZE) - pending;
+                size_t take = min(want, length);
+                memcpy(fixed + pending, data, take);
+                pending += take;
+                data += take;
+                length -= take;
+                if (take == want)
+                {
+                    pending = 0;
+                    if (state == HEADER)
+                        parseHeader();
+                    else
+                        parseControl();
+                }
+                break;
+            }
+            case ADD:
+                if (*data == 0)
+                {
+                    state = ADD_RUN;
+                }
+                else
+                {
+                    emitAdd(*data);
+                    nextAfterAdd();
+                }
+                data++;
+                length--;
+                break;
+            case ADD_RUN:
+            {
+                uint32_t run = (uint32_t)*data + 1;
+                data++;
+                length--;
+                if (run > addLeft)
+                    return fail("Zero run past block");
+                while (run-- && state != FAILED)
+                    emitAdd(0);
+                if (state != FAILED)
+                {
+                    state = ADD;
+                    nextAfterAdd();
+                }
+                break;
+            }
+            case EXTRA:
+            {
+                size_t take = min((size_t)extraLeft, length);
+                for (size_t i = 0; i < take; i++)
+                    emit(data[i]);
+                data += take;
+                length -= take;
+                extraLeft -= take;
+                if (!extraLeft)
+                    nextBlock();
+                break;
+            }
+            case DONE:
+                return fail("Data after end of image");
+            case FAILED:
+                break;
+            }
+        }
+        return state != FAILED;
+    }
+
+    bool done() const { return state == DONE; }
+
+    const char *getError() const { return error; }
+
+    uint32_t getProduced() const { return produced; }
+
+private:
+    enum State
+    {
+        HEADER,
+        CONTROL,
+        ADD,
+        ADD_RUN,
+        EXTRA,
+        DONE,
+        FAILED
+    };
+
+    static const size_t OUT_SIZE = 256;
+    static const size_t WINDOW_WORDS = 16;
+
+    ReadOld readOld;
+    WriteNew writeNew;
+    OnHeader onHeader;
+    State state;
+    DeltaHeader header;
+    uint8_t fixed[DELTA_HEADER_SIZE];
+    size_t pending;
+    uint32_t addLeft;
+    uint32_t extraLeft;
+    int32_t seek;
+    uint32_t oldPos;
+    uint32_t produced;
+    uint8_t out[OUT_SIZE];
+    size_t outLength;
+    uint32_t window[WINDOW_WORDS];
+    uint32_t windowStart;
+    bool windowValid;
+    const char *error;
+
+    static uint32_t readU32(const uint8_t *p)
+    {
+        return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+    }
+
+    bool fail(const char *message)
+    {
+        error = message;
+        state = FAILED;
+        return false;
+    }
+
+    void parseHeader()
+    {
+        memcpy(header.magic, fixed, 4);
+        header.oldSize = readU32(fixed + 4);
+        header.newSize = readU32(fixed + 8);
+        memcpy(header.oldMd5, fixed + 12, 16);
+        memcpy(header.newMd5, fixed + 28, 16);
+        if (memcmp(header.magic, "NLD1", 4))
+        {
+            fail("Not a delta");
+            return;
+        }
+        if (!onHeader(header))
+        {
+            fail("Delta rejected");
+            return;
+        }
+        nextBlock();
+    }
+
+    void parseControl()
+    {
+        addLeft = readU32(fixed);
+        extraLeft = readU32(fixed + 4);
+        seek = readU32(fixed + 8);
+        if ((uint64_t)addLeft + extraLeft > header.newSize - produced - outLength)
+        {
+            fail("Block past end of image");
+            return;
+        }
+        state = addLeft ? ADD : EXTRA;
+        if (!addLeft && !extraLeft)
+            nextBlock();
+    }
+
+    void nextAfterAdd()
+    {
+        if (!addLeft && state != FAILED)
+        {
+            if (extraLeft)
+                state = EXTRA;
+            else
+                nextBlock();
+        }
+    }
+
+    void nextBlock()
+    {
+        if (state == FAILED)
+            return;
+        oldPos += seek;
+        seek = 0;
+        if (produced + outLength < header.newSize)
+        {
+            state = CONTROL;
+            return;
+        }
+        flush();
+        if (state != FAILED)
+            state = DONE;
+    }
+
+    void emitAdd(uint8_t diff)
+    {
+        if (oldPos >= header.oldSize)
+        {
+            fail("Read past old image");
+            return;
+        }
+        uint32_t aligned = oldPos & ~3UL;
+        if (!windowValid || aligned < windowStart || oldPos >= windowStart + sizeof(window))
+        {
+            if (!readOld(aligned, window, sizeof(window)))
+            {
+                fail("Reading old image failed");
+                return;
+            }
+            windowStart = aligned;
+            windowValid = true;
+        }
+        uint8_t old = ((const uint8_t *)window)[oldPos - windowStart];
+        oldPos++;
+        addLeft--;
+        emit(old + diff);
+    }
+
+    void emit(uint8_t b)
+    {
+        out[outLength++] = b;
+        if (outLength == OUT_SIZE)
+            flush();
+    }
+
+    void flush()
+    {
+        if (!outLength)
+            return;
+        if (!writeNew(out, outLength))
+            fail("Writing new image failed");
+        produced += outLength;
+        outLength = 0;
+    }
+};
+
+#endif
@@ -1,7 +1,10 @@
 #ifndef LIGHTSENSOR_H
 #define LIGHTSENSOR_H
 #include <Arduino.h>
+#include "board.hpp"
 
+// Samples an analog pin once per second, scaled to 10 bit regardless of the board's ADC
+template <class Board>
 class AnalogRead
 {
 public:
@@ -16,19 +19,22 @@ private:
     int value;
 };
 
-AnalogRead::AnalogRead(uint8_t pin) : _pin(pin), updateInterval(1000L), nextUpdate(0) {}
+template <class Board>
+AnalogRead<Board>::AnalogRead(uint8_t pin) : _pin(pin), updateInterval(1000L), nextUpdate(0) {}
 
-void AnalogRead::loop()
+template <class Board>
+void AnalogRead<Board>::loop()
 {
     unsigned long time = millis();
     if (time > nextUpdate)
     {
         nextUpdate = max(nextUpdate + updateInterval, time);
-        value = analogRead(_pin);
+        value = rescale<Board::ADC_BITS, 10>(Board::readAdc(_pin));
     }
 }
 
-int AnalogRead::getValue()
+template <class Board>
+int AnalogRead<Board>::getValue()
 {
     return value;
 }
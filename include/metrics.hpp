@@ -0,0 +1,102 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <Arduino.h>
+
+enum MetricId
+{
+    METRIC_UPTIME,
+    METRIC_HEAP_FREE,
+    METRIC_HEAP_FREE_MIN,
+    METRIC_HEAP_MAX_BLOCK,
+    METRIC_HEAP_FRAGMENTATION,
+    METRIC_LOOP_ITERATIONS,
+    METRIC_LOOP_RATE,
+    METRIC_MQTT_RECEIVED,
+    METRIC_MQTT_PUBLISHED,
+    METRIC_MQTT_PUBLISH_FAILED,
+    METRIC_HTTP_REQUESTS,
+    METRIC_EEPROM_COMMITS,
+    METRIC_SLEEP_MILLIS,
+    METRIC_WAKEUPS,
+    METRIC_WAKE_LATENCY,
+    METRIC_WAKE_LATENCY_MAX,
+    METRIC_COUNT
+};
+
+enum MetricType
+{
+    COUNTER,
+    GAUGE
+};
+
+struct MetricInfo
+{
+    char name[44];
+    char key[8];
+    char help[48];
+    uint8_t type;
+};
+
+// Kept in flash, copied to the stack one entry at a time when exporting
+static const MetricInfo METRIC_INFO[METRIC_COUNT] PROGMEM = {
+    {"nightlight_uptime_seconds", "up", "Seconds since boot", GAUGE},
+    {"nightlight_heap_free_bytes", "heap", "Free heap", GAUGE},
+    {"nightlight_heap_free_min_bytes", "heapMin", "Lowest free heap seen since boot", GAUGE},
+    {"nightlight_heap_max_free_block_bytes", "block", "Largest allocatable heap block", GAUGE},
+    {"nightlight_heap_fragmentation_percent", "frag", "Heap fragmentation", GAUGE},
+    {"nightlight_loop_iterations_total", "loops", "Main loop iterations", COUNTER},
+    {"nightlight_loop_rate_hz", "loopHz", "Main loop iterations in the last second", GAUGE},
+    {"nightlight_mqtt_received_total", "mqttIn", "MQTT messages received", COUNTER},
+    {"nightlight_mqtt_published_total", "mqttOut", "MQTT messages published", COUNTER},
+    {"nightlight_mqtt_publish_failed_total", "mqttErr", "MQTT publishes rejected or not sent", COUNTER},
+    {"nightlight_http_requests_total", "http", "HTTP requests served", COUNTER},
+    {"nightlight_eeprom_commits_total", "eeprom", "Configuration writes to flash", COUNTER},
+    {"nightlight_sleep_milliseconds_total", "sleep", "Time spent in idle light sleep", COUNTER},
+    {"nightlight_wakeups_total", "wakeups", "Idle sleeps ended by a PIR edge", COUNTER},
+    {"nightlight_wake_latency_milliseconds", "wake", "PIR edge to wake-up latency, upper bound", GAUGE},
+    {"nightlight_wake_latency_max_milliseconds", "wakeMax", "Highest PIR edge to wake-up latency bound", GAUGE},
+};
+
+class Metrics
+{
+public:
+    Metrics() { memset(values, 0, sizeof(values)); }
+
+    void inc(MetricId id, uint32_t amount = 1) { values[id] += amount; }
+
+    void set(MetricId id, uint32_t value) { values[id] = value; }
+
+    uint32_t get(MetricId id) const { return values[id]; }
+
+    // Prometheus text exposition of a single metric
+    size_t format(MetricId id, char *buf, size_t size) const
+    {
+        MetricInfo info;
+        memcpy_P(&info, &METRIC_INFO[id], sizeof(info));
+        int length = snprintf(buf, size, "# HELP %s %s\n# TYPE %s %s\n%s %lu\n", info.name, info.help, info.name,
+                              info.type == COUNTER ? "counter" : "gauge", info.name, (unsigned long)values[id]);
+        return min((size_t)max(length, 0), size - 1);
+    }
+
+    // All metrics as one flat JSON object with short keys
+    size_t formatTelemetry(char *buf, size_t size) const
+    {
+        size_t length = 0;
+        for (int id = 0; id < METRIC_COUNT && length < size - 1; id++)
+        {
+            MetricInfo info;
+            memcpy_P(&info, &METRIC_INFO[id], sizeof(info));
+            int written = snprintf(buf + length, size - length, "%c\"%s\":%lu", id ? ',' : '{', info.key, (unsigned long)values[id]);
+            length = min(length + max(written, 0), size - 1);
+        }
+        if (length < size - 1)
+            buf[length++] = '}';
+        buf[length] = '\0';
+        return length;
+    }
+
+private:
+    uint32_t values[METRIC_COUNT];
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+#include <Arduino.h>
+
+static const uint8_t HOURS_PER_WEEK = 7 * 24;
+
+// Motion statistics per hour of the week, learned from PIR edges.
+// Small enough to be stored with the configuration.
+class OccupancyModel
+{
+public:
+    // Gaps longer than this mean the room was left and entered again
+    static const uint32_t PRESENCE_GAP = 10 * 60000L;
+
+    OccupancyModel() { memset(buckets, 0, sizeof(buckets)); }
+
+    // Rising PIR edge, gap is the time since the previous one
+    void onMotion(uint8_t hourOfWeek, uint32_t gap)
+    {
+        if (gap >= PRESENCE_GAP)
+            return;
+        Bucket &b = buckets[hourOfWeek];
+        int32_t sample = gap / (1000 / GAP_SCALE);
+        if (!b.gap)
+            b.gap = max(sample, (int32_t)1);
+        else
+            b.gap += (sample - (int32_t)b.gap) / 8;
+    }
+
+    // Moves the activity of the hour that just ended towards 255 if it saw motion, 0 otherwise
+    void endHour(uint8_t hourOfWeek, bool motion)
+    {
+        Bucket &b = buckets[hourOfWeek];
+        if (motion)
+            b.activity += (255 - b.activity + 7) >> 3;
+        else
+            b.activity -= (b.activity + 7) >> 3;
+    }
+
+    // Idle timeout for a state whose fixed timeout is base: long enough to cover the usual
+    // stillness between two movements in this hour, short when the hour is rarely occupied
+    uint32_t timeout(uint8_t hourOfWeek, uint32_t base) const
+    {
+        const Bucket &b = buckets[hourOfWeek];
+        if (!b.gap)
+            return base;
+        uint32_t learned = 2UL * b.gap * (1000 / GAP_SCALE);
+        uint32_t longest = b.activity < RARE_ACTIVITY ? base : base * 8;
+        return constrain(learned, base / 2, longest);
+    }
+
+    // Occupied in most recent weeks
+    bool expectsActivity(uint8_t hourOfWeek) const
+    {
+        return buckets[hourOfWeek].activity >= LIKELY_ACTIVITY;
+    }
+
+    // Occupied in most recent weeks, unlike the hour before it
+    bool startsActivity(uint8_t hourOfWeek) const
+    {
+        return expectsActivity(hourOfWeek) && !expectsActivity((hourOfWeek + HOURS_PER_WEEK - 1) % HOURS_PER_WEEK);
+    }
+
+    uint8_t activity(uint8_t hourOfWeek) const { return buckets[hourOfWeek].activity; }
+
+    uint32_t gap(uint8_t hourOfWeek) const { return buckets[hourOfWeek].gap * (1000 / GAP_SCALE); }
+
+private:
+    static const uint8_t GAP_SCALE = 4; // gap is stored in quarter seconds
+    static const uint8_t RARE_ACTIVITY = 32;
+    static const uint8_t LIKELY_ACTIVITY = 192;
+
+    struct Bucket
+    {
+        uint16_t gap;
+        uint8_t activity;
+        uint8_t reserved;
+    };
+    Bucket buckets[HOURS_PER_WEEK];
+};
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef PEER_H
+#define PEER_H
+#include <Arduino.h>
+
+enum PeerMessage
+{
+    PEER_MOTION = 1,
+    PEER_STATE = 2,
+    PEER_ALARM = 3
+};
+
+// Times are UTC epoch milliseconds of the clock they were taken from
+struct PeerFrame
+{
+    uint8_t type;
+    uint16_t node;
+    uint8_t zone;
+    uint8_t value;
+    uint64_t sentAt;
+    uint64_t at;
+};
+
+static const uint8_t PEER_VERSION = 1;
+// 'N' 'L' version type | node | zone value | sentAt (48 bit) | at (48 bit)
+static const size_t PEER_FRAME_SIZE = 20;
+
+inline size_t encodePeerFrame(const PeerFrame &frame, uint8_t *buf)
+{
+    buf[0] = 'N';
+    buf[1] = 'L';
+    buf[2] = PEER_VERSION;
+    buf[3] = frame.type;
+    buf[4] = frame.node;
+    buf[5] = frame.node >> 8;
+    buf[6] = frame.zone;
+    buf[7] = frame.value;
+    for (int i = 0; i < 6; i++)
+    {
+        buf[8 + i] = frame.sentAt >> (8 * i);
+        buf[14 + i] = frame.at >> (8 * i);
+    }
+    return PEER_FRAME_SIZE;
+}
+
+inline bool decodePeerFrame(const uint8_t *buf, size_t length, PeerFrame &frame)
+{
+    if (length < PEER_FRAME_SIZE || buf[0] != 'N' || buf[1] != 'L' || buf[2] != PEER_VERSION)
+        return false;
+    frame.type = buf[3];
+    frame.node = buf[4] | buf[5] << 8;
+    frame.zone = buf[6];
+    frame.value = buf[7];
+    frame.sentAt = 0;
+    frame.at = 0;
+    for (int i = 0; i < 6; i++)
+    {
+        frame.sentAt |= (uint64_t)buf[8 + i] << (8 * i);
+        frame.at |= (uint64_t)buf[14 + i] << (8 * i);
+    }
+    return true;
+}
+
+// Smoothed clock offset (peer minus local) of the most recently heard peers.
+// The one-way network delay is part of the offset, on a LAN it is a few ms.
+class PeerClocks
+{
+public:
+    PeerClocks() { memset(peers, 0, sizeof(peers)); }
+
+    int32_t update(uint16_t node, int64_t sample)
+    {
+        sample = constrain(sample, (int64_t)INT32_MIN, (int64_t)INT32_MAX);
+        Peer *peer = find(node);
+        if (!peer)
+        {
+            // Replace the least recently heard peer
+            peer = &peers[0];
+            for (Peer &p : peers)
+                if (p.heard < peer->heard)
+                    peer = &p;
+            peer->node = node;
+            peer->offset = sample;
+        }
+        else
+        {
+            peer->offset += (sample - peer->offset) / 4;
+        }
+        peer->heard = ++heardCounter;
+        return peer->offset;
+    }
+
+private:
+    struct Peer
+    {
+        uint16_t node;
+        int32_t offset;
+        uint32_t heard;
+    };
+    Peer peers[8];
+    uint32_t heardCounter = 0;
+
+    Peer *find(uint16_t node)
+    {
+        for (Peer &p : peers)
+            if (p.heard && p.node == node)
+                return &p;
+        return nullptr;
+    }
+};
+
+// Broadcasts and receives PeerFrames on a multicast group. Addresses are IPv4 in network byte order, as
+// IPAddress converts to uint32_t. The Udp policy owns the socket and provides:
+//   join(local, group, port)              - listen on the group through the interface at local
+//   send(local, group, port, data, size)  - send one datagram to the group
+//   pending()                             - a datagram is waiting, it stays queued
+//   receive(buf, size)                    - take the next datagram, returns its full size or 0
+// WiFiPeerUdp (peerudp.hpp) is the device policy, the native tests bring a socket based one.
+template <class Udp>
+class PeerLink
+{
+public:
+    PeerLink(uint32_t group, uint16_t port) : group(group), port(port), local(0), node(0), ready(false) {}
+
+    void begin(uint32_t _local, uint16_t _node)
+    {
+        local = _local;
+        node = _node;
+        ready = udp.join(local, group, port);
+    }
+
+    uint16_t getNode() const { return node; }
+
+    void send(PeerMessage type, uint8_t zone, uint8_t value, uint64_t now, uint64_t at = 0)
+    {
+        if (!ready)
+            return;
+        PeerFrame frame = {(uint8_t)type, node, zone, value, now, at};
+        uint8_t buf[PEER_FRAME_SIZE];
+        size_t length = encodePeerFrame(frame, buf);
+        udp.send(local, group, port, buf, length);
+    }
+
+    bool pending() { return ready && udp.pending(); }
+
+    // Reads one frame from another node. frame.at is translated to the local clock.
+    bool receive(PeerFrame &frame, uint64_t now)
+    {
+        if (!ready)
+            return false;
+        uint8_t buf[PEER_FRAME_SIZE];
+        while (int size = udp.receive(buf, sizeof(buf)))
+        {
+            if (size != (int)PEER_FRAME_SIZE || !decodePeerFrame(buf, size, frame) || frame.node == node)
+                continue;
+            int32_t offset = clocks.update(frame.node, (int64_t)frame.sentAt - (int64_t)now);
+            if (frame.at)
+                frame.at -= offset;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    Udp udp;
+    PeerClocks clocks;
+    uint32_t group;
+    uint16_t port;
+    uint32_t local;
+    uint16_t node;
+    bool ready;
+};
+
+#endif
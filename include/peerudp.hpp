@@ -0,0 +1,44 @@
+#ifndef PEERUDP_H
+#define PEERUDP_H
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+// PeerLink's Udp policy on top of the ESP8266 WiFiUDP. parsePacket() drops the current datagram,
+// so one that was only looked at by pending() is kept until receive() takes it.
+class WiFiPeerUdp
+{
+public:
+    WiFiPeerUdp() : held(0) {}
+
+    bool join(uint32_t local, uint32_t group, uint16_t port) { return udp.beginMulticast(IPAddress(local), IPAddress(group), port); }
+
+    void send(uint32_t local, uint32_t group, uint16_t port, const uint8_t *data, size_t size)
+    {
+        udp.beginPacketMulticast(IPAddress(group), port, IPAddress(local));
+        udp.write(data, size);
+        udp.endPacket();
+    }
+
+    bool pending()
+    {
+        if (!held)
+            held = udp.parsePacket();
+        return held > 0;
+    }
+
+    int receive(uint8_t *buf, size_t size)
+    {
+        if (!pending())
+            return 0;
+        int length = held;
+        held = 0;
+        udp.read(buf, min(size, (size_t)length));
+        return length;
+    }
+
+private:
+    WiFiUDP udp;
+    int held;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <Arduino.h>
+
+// Inputs of the lighting logic, in the order loop() saw them
+enum TraceKind
+{
+    TRACE_BOOT = 1,       // value: config version
+    TRACE_PIR = 2,        // arg: bit mask of active PIRs
+    TRACE_LIGHT = 3,      // value: light sensor reading
+    TRACE_EPOCH_HIGH = 4, // arg: TraceClock, value: upper 16 bits of the UTC epoch, followed by TRACE_EPOCH_LOW
+    TRACE_EPOCH_LOW = 5,  // value: lower 16 bits
+    TRACE_MQTT = 6,       // arg: topic id, value: payload length, followed by the payload
+    TRACE_MQTT_DATA = 7,  // arg, value: three payload bytes
+    TRACE_PEER = 8,       // arg: PeerMessage, value: sending node, followed by TRACE_PEER_DATA
+    TRACE_PEER_DATA = 9,  // arg: zone, value: frame value, followed by TRACE_PEER_AT for timed frames
+    TRACE_PEER_AT = 10    // value: frame time minus receive time in 100 ms, signed
+};
+
+// Where the epoch of a TRACE_EPOCH_HIGH came from. Only NTP time enables the learned behaviour.
+enum TraceClock
+{
+    TRACE_CLOCK_UPTIME = 0,   // not set yet, seconds since boot
+    TRACE_CLOCK_RESTORED = 1, // from RTC memory or flash, saved before the reboot
+    TRACE_CLOCK_NTP = 2
+};
+
+struct TraceRecord
+{
+    uint32_t millis;
+    uint8_t kind;
+    uint8_t arg;
+    uint16_t value;
+};
+
+// Header of a downloaded trace, little endian. It is followed by snapshotSize bytes of configuration
+// (the firmware's Config at download time, without the WiFi cache), then count records, oldest first.
+// After the ring wrapped, the first records may be the tail of an epoch, MQTT or peer group.
+struct TraceHeader
+{
+    char magic[4];
+    uint8_t version;
+    uint8_t recordSize;
+    uint16_t count;
+    uint16_t snapshotSize;
+};
+
+static const uint8_t TRACE_VERSION = 4;
+static const uint8_t TRACE_MAX_PAYLOAD = 15;
+
+template <uint16_t N>
+class TraceRecorder
+{
+public:
+    TraceRecorder() : next(0), count(0) {}
+
+    void record(uint32_t millis, TraceKind kind, uint8_t arg = 0, uint16_t value = 0)
+    {
+        TraceRecord &r = records[next];
+        r.millis = millis;
+        r.kind = kind;
+        r.arg = arg;
+        r.value = value;
+        next = (next + 1) % N;
+        if (count < N)
+            count++;
+    }
+
+    void recordEpoch(uint32_t millis, uint32_t epoch, TraceClock source)
+    {
+        record(millis, TRACE_EPOCH_HIGH, source, epoch >> 16);
+        record(millis, TRACE_EPOCH_LOW, 0, epoch);
+    }
+
+    void recordMqtt(uint32_t millis, uint8_t topic, const uint8_t *payload, unsigned int length)
+    {
+        length = min(length, (unsigned int)TRACE_MAX_PAYLOAD);
+        record(millis, TRACE_MQTT, topic, length);
+        for (unsigned int i = 0; i < length; i += 3)
+        {
+            uint8_t b1 = i + 1 < length ? payload[i + 1] : 0;
+            uint8_t b2 = i + 2 < length ? payload[i + 2] : 0;
+            record(millis, TRACE_MQTT_DATA, payload[i], b1 | b2 << 8);
+        }
+    }
+
+    // at is relative to millis and only recorded for timed frames
+    void recordPeer(uint32_t millis, uint8_t type, uint16_t node, uint8_t zone, uint8_t value, bool timed, int32_t at)
+    {
+        record(millis, TRACE_PEER, type, node);
+        record(millis, TRACE_PEER_DATA, zone, value);
+        if (timed)
+            record(millis, TRACE_PEER_AT, 0, (uint16_t)constrain(at / 100, -32768L, 32767L));
+    }
+
+    void clear()
+    {
+        next = 0;
+        count = 0;
+    }
+
+    TraceHeader header(uint16_t snapshotSize) const
+    {
+        TraceHeader h = {{'N', 'L', 'T', 'R'}, TRACE_VERSION, sizeof(TraceRecord), count, snapshotSize};
+        return h;
+    }
+
+    // Calls write(data, length) at most twice with the records, oldest first
+    template <class Write>
+    void dump(Write write) const
+    {
+        uint16_t first = (next + N - count) % N;
+        uint16_t tail = min((uint16_t)(N - first), count);
+        write((const uint8_t *)&records[first], tail * sizeof(TraceRecord));
+        if (count > tail)
+            write((const uint8_t *)&records[0], (count - tail) * sizeof(TraceRecord));
+    }
+
+private:
+    TraceRecord records[N];
+    uint16_t next;
+    uint16_t count;
+};
+
+#endif
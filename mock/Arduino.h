@@ -0,0 +1,98 @@
+#ifndef MOCK_ARDUINO_H
+#define MOCK_ARDUINO_H
+// Host stand-in for the ESP8266 Arduino core, used by the native test and replay environments.
+// Time only moves when a test or the replayer advances it; pin state lives in the mock namespace.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <cstdlib>
+#include <algorithm>
+#include "pgmspace.h"
+#include "WString.h"
+
+typedef uint8_t byte;
+using std::abs;
+using std::max;
+using std::min;
+
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+#define A0 17
+#define LED_BUILTIN 2
+#define MOCK_PINS 18
+
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+#define LOW 0
+#define HIGH 1
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define digitalPinToInterrupt(p) (p)
+
+namespace mock
+{
+// Current time in milliseconds
+extern unsigned long now;
+// Called after every simulated millisecond, e.g. to feed recorded inputs while the firmware sleeps
+extern void (*onTick)();
+void advance(unsigned long ms);
+
+extern int digital[MOCK_PINS];
+extern int analog[MOCK_PINS];
+extern int pwm[MOCK_PINS];
+extern uint8_t mode[MOCK_PINS];
+// Changes a digital input and runs an attached interrupt handler on the matching edge
+void setDigital(uint8_t pin, int value);
+void reset();
+} // namespace mock
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+void analogWriteRange(uint32_t range);
+void analogWriteResolution(int bits);
+int analogRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode);
+void detachInterrupt(uint8_t pin);
+long random(long max);
+long random(long min, long max);
+
+class EspClass
+{
+public:
+    uint32_t getFreeHeap() { return 40000; }
+    uint32_t getMaxFreeBlockSize() { return 30000; }
+    uint8_t getHeapFragmentation() { return 10; }
+    uint32_t getChipId() { return 0xc0ffee; }
+    uint32_t getCycleCount() { return mock::now * 80000; }
+    bool rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size);
+    bool rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size);
+    bool flashRead(uint32_t address, uint32_t *data, size_t size);
+    uint32_t getSketchSize() { return 0; }
+    uint32_t getFreeSketchSpace() { return 0x100000; }
+    String getSketchMD5() { return String(); }
+    void restart() {}
+};
+
+extern EspClass ESP;
+
+#endif
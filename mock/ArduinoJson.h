@@ -0,0 +1,57 @@
+#ifndef MOCK_ARDUINOJSON_H
+#define MOCK_ARDUINOJSON_H
+#include <Arduino.h>
+
+// Accepts the document API the firmware uses. Nothing is stored, every value reads as empty.
+class JsonArray
+{
+};
+
+class JsonVariant
+{
+public:
+    JsonVariant operator[](const char *) const { return JsonVariant(); }
+    JsonVariant operator[](int) const { return JsonVariant(); }
+    JsonVariant createNestedObject() { return JsonVariant(); }
+    JsonVariant createNestedArray() { return JsonVariant(); }
+
+    template <class T>
+    JsonVariant &operator=(const T &)
+    {
+        return *this;
+    }
+
+    template <class T>
+    bool add(const T &)
+    {
+        return true;
+    }
+
+    template <class T>
+    T to()
+    {
+        return T();
+    }
+
+    template <class T>
+    operator T() const
+    {
+        return T();
+    }
+};
+
+template <size_t N>
+class StaticJsonDocument : public JsonVariant
+{
+};
+
+class DynamicJsonDocument : public JsonVariant
+{
+public:
+    DynamicJsonDocument(size_t) {}
+};
+
+inline void deserializeJson(JsonVariant &, const String &) {}
+inline void serializeJson(const JsonVariant &, String &out) { out = "null"; }
+
+#endif
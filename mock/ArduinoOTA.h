@@ -0,0 +1,14 @@
+#ifndef MOCK_ARDUINOOTA_H
+#define MOCK_ARDUINOOTA_H
+
+class ArduinoOTAClass
+{
+public:
+    void setPassword(const char *) {}
+    void begin() {}
+    void handle() {}
+};
+
+extern ArduinoOTAClass ArduinoOTA;
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef MOCK_EEPROM_H
+#define MOCK_EEPROM_H
+#include <Arduino.h>
+
+// 4 kB of emulated flash, erased to zeros
+class EEPROMClass
+{
+public:
+    void begin(size_t) {}
+    bool commit() { return true; }
+    bool end() { return true; }
+
+    template <class T>
+    T &get(int address, T &t)
+    {
+        memcpy((void *)&t, data() + address, sizeof(T));
+        return t;
+    }
+
+    template <class T>
+    const T &put(int address, const T &t)
+    {
+        memcpy(data() + address, (const void *)&t, sizeof(T));
+        return t;
+    }
+
+    static uint8_t *data()
+    {
+        static uint8_t bytes[4096];
+        return bytes;
+    }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef MOCK_ESP8266WEBSERVER_H
+#define MOCK_ESP8266WEBSERVER_H
+#include <ESP8266WiFi.h>
+#include <functional>
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
+enum HTTPMethod
+{
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_POST
+};
+
+enum HTTPUploadStatus
+{
+    UPLOAD_FILE_START,
+    UPLOAD_FILE_WRITE,
+    UPLOAD_FILE_END,
+    UPLOAD_FILE_ABORTED
+};
+
+struct HTTPUpload
+{
+    HTTPUploadStatus status;
+    String filename;
+    size_t totalSize;
+    size_t currentSize;
+    uint8_t buf[2048];
+};
+
+// Never sees a client, routes are accepted and dropped
+class ESP8266WebServer
+{
+public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    ESP8266WebServer(int = 80) {}
+    void on(const char *, THandlerFunction) {}
+    void on(const char *, HTTPMethod, THandlerFunction, THandlerFunction) {}
+    void begin() {}
+    void handleClient() {}
+    void send(int, const char * = NULL, const String & = String()) {}
+    void setContentLength(size_t) {}
+    void sendContent(const String &) {}
+    void sendContent(const char *, size_t) {}
+    String arg(const char *) { return String(); }
+    bool authenticate(const char *, const char *) { return false; }
+    void requestAuthentication() {}
+    HTTPUpload &upload() { return _upload; }
+
+private:
+    HTTPUpload _upload;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef MOCK_ESP8266WIFI_H
+#define MOCK_ESP8266WIFI_H
+#include <Arduino.h>
+#include "WiFiUdp.h"
+
+class WiFiClient
+{
+};
+
+enum WiFiSleepType_t
+{
+    WIFI_NONE_SLEEP,
+    WIFI_LIGHT_SLEEP,
+    WIFI_MODEM_SLEEP
+};
+
+// Always associated unless a test says otherwise
+class WiFiClass
+{
+public:
+    void hostname(const char *) {}
+    int begin(const char *, const char *, int32_t = 0, const uint8_t * = NULL, bool = true) { return 0; }
+    bool config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress()) { return true; }
+    void setAutoConnect(bool) {}
+    void setAutoReconnect(bool) {}
+    void persistent(bool) {}
+    bool setSleepMode(WiFiSleepType_t, uint8_t = 0) { return true; }
+    bool isConnected();
+    int32_t channel() { return 6; }
+    uint8_t *BSSID();
+    IPAddress localIP() { return IPAddress(192, 168, 0, 50); }
+    IPAddress gatewayIP() { return IPAddress(192, 168, 0, 1); }
+    IPAddress subnetMask() { return IPAddress(255, 255, 255, 0); }
+    IPAddress dnsIP(uint8_t = 0) { return IPAddress(192, 168, 0, 1); }
+};
+
+extern WiFiClass WiFi;
+
+namespace mock
+{
+extern bool wifiConnected;
+}
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef MOCK_NTPCLIENT_H
+#define MOCK_NTPCLIENT_H
+#include <ESP8266WiFi.h>
+
+// Reports the epoch given to mock::setEpoch(), advancing with millis(). update() returns true once
+// after an epoch that came from NTP.
+class NTPClient
+{
+public:
+    NTPClient(WiFiUDP &) {}
+    void setUpdateInterval(unsigned long) {}
+    bool update();
+    unsigned long getEpochTime() const;
+};
+
+namespace mock
+{
+void setEpoch(unsigned long epoch, bool fromNtp = true);
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef MOCK_PIR_H
+#define MOCK_PIR_H
+#include <Arduino.h>
+#include <vector>
+
+struct PirInfo
+{
+    const char *name;
+    bool state;
+};
+
+// Follows its digital input, see mock::setDigital()
+class PIR
+{
+public:
+    PIR(uint8_t pin, void (*callback)(PirInfo *), const char *name);
+    void loop();
+    bool getState() { return info.state; }
+
+private:
+    uint8_t pin;
+    void (*callback)(PirInfo *);
+    PirInfo info;
+};
+
+namespace mock
+{
+// Input pins of the PIRs in construction order
+std::vector<uint8_t> &pirPins();
+}
+
+#endif
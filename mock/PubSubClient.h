@@ -0,0 +1,37 @@
+#ifndef MOCK_PUBSUBCLIENT_H
+#define MOCK_PUBSUBCLIENT_H
+#include <ESP8266WiFi.h>
+#include <string>
+#include <vector>
+
+// Connects at once. Messages queued with mock::receiveMqtt() reach the callback from loop(), as they would
+// from the broker.
+class PubSubClient
+{
+public:
+    typedef void (*Callback)(char *, uint8_t *, unsigned int);
+
+    PubSubClient(WiFiClient &) : isConnected(false), callback(NULL) {}
+    void setServer(const char *, uint16_t) {}
+    bool setBufferSize(uint16_t) { return true; }
+    void setCallback(Callback _callback) { callback = _callback; }
+    bool connect(const char *) { return isConnected = true; }
+    bool connected() { return isConnected; }
+    bool loop();
+    bool subscribe(const char *topic);
+    bool publish(const char *, const char *, bool = false) { return isConnected; }
+    bool publish(const char *, const uint8_t *, unsigned int, bool = false) { return isConnected; }
+
+private:
+    bool isConnected;
+    Callback callback;
+};
+
+namespace mock
+{
+// Topics in the order the firmware subscribed to them
+std::vector<std::string> &subscriptions();
+void receiveMqtt(const std::string &topic, const std::string &payload);
+} // namespace mock
+
+#endif
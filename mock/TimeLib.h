@@ -0,0 +1,27 @@
+#ifndef MOCK_TIMELIB_H
+#define MOCK_TIMELIB_H
+#include <Arduino.h>
+#include <time.h>
+
+#define SECS_PER_MIN 60L
+#define SECS_PER_HOUR 3600L
+#define SECS_PER_DAY 86400L
+#define SECS_PER_WEEK (SECS_PER_DAY * 7)
+#define elapsedSecsToday(t) ((t) % SECS_PER_DAY)
+
+// The system clock runs on millis() from the last setTime(), like the real library
+time_t now();
+void setTime(time_t t);
+int hour(time_t t);
+int minute(time_t t);
+int second(time_t t);
+int day(time_t t);
+int month(time_t t);
+int year(time_t t);
+int weekday(time_t t); // 1 is Sunday
+int hour();
+int minute();
+int second();
+int weekday();
+
+#endif
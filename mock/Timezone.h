@@ -0,0 +1,66 @@
+#ifndef MOCK_TIMEZONE_H
+#define MOCK_TIMEZONE_H
+#include <TimeLib.h>
+
+enum week_t
+{
+    Last,
+    First,
+    Second,
+    Third,
+    Fourth
+};
+
+enum dow_t
+{
+    Sun = 1,
+    Mon,
+    Tue,
+    Wed,
+    Thu,
+    Fri,
+    Sat
+};
+
+enum month_t
+{
+    Jan = 1,
+    Feb,
+    Mar,
+    Apr,
+    May,
+    Jun,
+    Jul,
+    Aug,
+    Sep,
+    Oct,
+    Nov,
+    Dec
+};
+
+struct TimeChangeRule
+{
+    char abbrev[6];
+    uint8_t week;
+    uint8_t dow;
+    uint8_t month;
+    uint8_t hour;
+    int offset; // minutes from UTC
+};
+
+// Same rules as the Timezone library, for the northern and southern hemisphere
+class Timezone
+{
+public:
+    Timezone(TimeChangeRule dst, TimeChangeRule std) : dst(dst), std(std) {}
+    time_t toLocal(time_t utc);
+    bool utcIsDST(time_t utc);
+
+private:
+    TimeChangeRule dst;
+    TimeChangeRule std;
+
+    time_t toTime(const TimeChangeRule &rule, int year);
+};
+
+#endif
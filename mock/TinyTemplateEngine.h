@@ -0,0 +1,3 @@
+#ifndef MOCK_TINYTEMPLATEENGINE_H
+#define MOCK_TINYTEMPLATEENGINE_H
+#endif
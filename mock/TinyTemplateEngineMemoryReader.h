@@ -0,0 +1,3 @@
+#ifndef MOCK_TINYTEMPLATEENGINEMEMORYREADER_H
+#define MOCK_TINYTEMPLATEENGINEMEMORYREADER_H
+#endif
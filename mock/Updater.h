@@ -0,0 +1,19 @@
+#ifndef MOCK_UPDATER_H
+#define MOCK_UPDATER_H
+#include <Arduino.h>
+
+// Accepts and discards an image
+class UpdaterClass
+{
+public:
+    bool begin(size_t) { return true; }
+    size_t write(uint8_t *, size_t size) { return size; }
+    bool end(bool = false) { return true; }
+    bool setMD5(const char *) { return true; }
+    bool hasError() { return false; }
+    uint8_t getError() { return 0; }
+};
+
+extern UpdaterClass Update;
+
+#endif
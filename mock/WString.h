@@ -0,0 +1,73 @@
+#ifndef MOCK_WSTRING_H
+#define MOCK_WSTRING_H
+// The subset of Arduino's String that the firmware uses, backed by std::string
+#include <cstdlib>
+#include <string>
+
+#define DEC 10
+#define HEX 16
+
+class String
+{
+public:
+    String() {}
+    String(const char *s) : s(s ? s : "") {}
+    String(const std::string &s) : s(s) {}
+    explicit String(char c) : s(1, c) {}
+    String(int value, unsigned char base = DEC) { append((long long)value, base); }
+    String(unsigned int value, unsigned char base = DEC) { append((unsigned long long)value, base); }
+    String(long value, unsigned char base = DEC) { append((long long)value, base); }
+    String(unsigned long value, unsigned char base = DEC) { append((unsigned long long)value, base); }
+
+    const char *c_str() const { return s.c_str(); }
+    unsigned int length() const { return s.size(); }
+    bool equals(const String &other) const { return s == other.s; }
+    bool equals(const char *other) const { return s == other; }
+    int toInt() const { return atoi(s.c_str()); }
+
+    String &operator+=(const String &other) { s += other.s; return *this; }
+    String &operator+=(const char *other) { s += other; return *this; }
+    String &operator+=(char c) { s += c; return *this; }
+    String &operator+=(int value) { append((long long)value, DEC); return *this; }
+    String &operator+=(unsigned int value) { append((unsigned long long)value, DEC); return *this; }
+    String &operator+=(long value) { append((long long)value, DEC); return *this; }
+    String &operator+=(unsigned long value) { append((unsigned long long)value, DEC); return *this; }
+
+    bool operator==(const String &other) const { return s == other.s; }
+    bool operator==(const char *other) const { return s == other; }
+    bool operator!=(const String &other) const { return s != other.s; }
+    bool operator!=(const char *other) const { return s != other; }
+
+    friend String operator+(const String &a, const String &b) { return String(a.s + b.s); }
+    friend String operator+(const String &a, const char *b) { return String(a.s + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b.s); }
+
+private:
+    std::string s;
+
+    void append(unsigned long long value, unsigned char base)
+    {
+        char buf[24];
+        char *p = buf + sizeof(buf);
+        *--p = '\0';
+        do
+        {
+            *--p = "0123456789abcdef"[value % base];
+            value /= base;
+        } while (value);
+        s += p;
+    }
+
+    void append(long long value, unsigned char base)
+    {
+        if (value < 0 && base == DEC)
+        {
+            s += '-';
+            append((unsigned long long)-value, base);
+        }
+        else
+            append((unsigned long long)value, base);
+    }
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef MOCK_WIFIUDP_H
+#define MOCK_WIFIUDP_H
+#include <Arduino.h>
+#include <vector>
+
+class IPAddress
+{
+public:
+    IPAddress() : address(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+    IPAddress(uint32_t address) : address(address) {}
+    operator uint32_t() const { return address; }
+    bool isSet() const { return address != 0; }
+    String toString() const
+    {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", address & 0xff, address >> 8 & 0xff, address >> 16 & 0xff, address >> 24);
+        return String(buf);
+    }
+
+private:
+    uint32_t address;
+};
+
+// Every WiFiUDP that joined a multicast group receives the datagrams queued with mock::receiveUdp()
+class WiFiUDP
+{
+public:
+    uint8_t begin(uint16_t) { return 1; }
+    uint8_t beginMulticast(IPAddress, IPAddress, uint16_t);
+    int beginPacket(IPAddress, uint16_t) { return 1; }
+    int beginPacketMulticast(IPAddress, uint16_t, IPAddress, int = 1) { return 1; }
+    size_t write(const uint8_t *, size_t size) { return size; }
+    int endPacket() { return 1; }
+    int parsePacket();
+    int read(uint8_t *buf, size_t size);
+    IPAddress remoteIP() { return IPAddress(); }
+
+private:
+    std::vector<uint8_t> packet;
+    size_t position = 0;
+    size_t received = 0;
+};
+
+namespace mock
+{
+void receiveUdp(const uint8_t *data, size_t size);
+}
+
+#endif
@@ -0,0 +1,10 @@
+// Placeholder credentials for host builds. Distinct topics, so the firmware can tell them apart.
+const char *ssid = "mock";
+const char *wifi_password = "";
+const char *ota_password = "";
+const char *mqttServer = "localhost";
+
+const char *BEDLIGHT_BASE_TOPIC = "bedlight/";
+const char *NIGHTLIGHT_TOPIC = "bedlight/nightlight";
+const char *ALARM_SET_TOPIC = "bedlight/alarm/set";
+const char *ALARM_STATE_TOPIC = "bedlight/alarm/state";
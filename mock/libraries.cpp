@@ -0,0 +1,247 @@
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <ESP8266WebServer.h>
+#include <PubSubClient.h>
+#include <ArduinoOTA.h>
+#include <Updater.h>
+#include <NTPClient.h>
+#include <PIR.h>
+#include <TimeLib.h>
+#include <Timezone.h>
+#include <EEPROM.h>
+#include <deque>
+
+WiFiClass WiFi;
+ArduinoOTAClass ArduinoOTA;
+UpdaterClass Update;
+EEPROMClass EEPROM;
+
+namespace mock
+{
+bool wifiConnected = true;
+
+static std::deque<std::vector<uint8_t>> &udpQueue()
+{
+    static std::deque<std::vector<uint8_t>> queue;
+    return queue;
+}
+
+void receiveUdp(const uint8_t *data, size_t size)
+{
+    udpQueue().push_back(std::vector<uint8_t>(data, data + size));
+}
+
+std::vector<std::string> &subscriptions()
+{
+    static std::vector<std::string> topics;
+    return topics;
+}
+
+static std::deque<std::pair<std::string, std::string>> &mqttQueue()
+{
+    static std::deque<std::pair<std::string, std::string>> queue;
+    return queue;
+}
+
+void receiveMqtt(const std::string &topic, const std::string &payload) { mqttQueue().push_back(std::make_pair(topic, payload)); }
+
+static unsigned long epoch = 0;
+static unsigned long epochSet = 0;
+static bool epochFresh = false;
+
+void setEpoch(unsigned long _epoch, bool fromNtp)
+{
+    epoch = _epoch;
+    epochSet = now;
+    epochFresh = fromNtp;
+}
+
+std::vector<uint8_t> &pirPins()
+{
+    static std::vector<uint8_t> pins;
+    return pins;
+}
+} // namespace mock
+
+bool WiFiClass::isConnected() { return mock::wifiConnected; }
+
+uint8_t *WiFiClass::BSSID()
+{
+    static uint8_t bssid[6] = {0x02, 0, 0, 0, 0, 1};
+    return bssid;
+}
+
+// A single shared queue: the firmware has one multicast listener, the NTP client never reads its socket
+uint8_t WiFiUDP::beginMulticast(IPAddress, IPAddress, uint16_t) { return 1; }
+
+int WiFiUDP::parsePacket()
+{
+    std::deque<std::vector<uint8_t>> &queue = mock::udpQueue();
+    if (queue.empty())
+    {
+        packet.clear();
+        return 0;
+    }
+    packet = queue.front();
+    queue.pop_front();
+    position = 0;
+    return packet.size();
+}
+
+int WiFiUDP::read(uint8_t *buf, size_t size)
+{
+    size_t length = min(size, packet.size() - position);
+    memcpy(buf, packet.data() + position, length);
+    position += length;
+    return length;
+}
+
+bool PubSubClient::loop()
+{
+    std::deque<std::pair<std::string, std::string>> &queue = mock::mqttQueue();
+    while (isConnected && callback && !queue.empty())
+    {
+        std::string topic = queue.front().first;
+        std::string payload = queue.front().second;
+        queue.pop_front();
+        callback(&topic[0], (uint8_t *)&payload[0], payload.size());
+    }
+    return isConnected;
+}
+
+bool PubSubClient::subscribe(const char *topic)
+{
+    mock::subscriptions().push_back(topic);
+    return isConnected;
+}
+
+bool NTPClient::update()
+{
+    bool fresh = mock::epochFresh && mock::wifiConnected;
+    if (fresh)
+        mock::epochFresh = false;
+    return fresh;
+}
+
+unsigned long NTPClient::getEpochTime() const
+{
+    if (!mock::epoch)
+        return millis() / 1000;
+    return mock::epoch + (millis() - mock::epochSet) / 1000;
+}
+
+PIR::PIR(uint8_t pin, void (*callback)(PirInfo *), const char *name) : pin(pin), callback(callback)
+{
+    info.name = name;
+    info.state = false;
+    mock::pirPins().push_back(pin);
+}
+
+void PIR::loop()
+{
+    bool state = digitalRead(pin);
+    if (state == info.state)
+        return;
+    info.state = state;
+    callback(&info);
+}
+
+static time_t sysTime = 0;
+static unsigned long sysTimeSet = 0;
+
+time_t now() { return sysTime + (millis() - sysTimeSet) / 1000; }
+
+void setTime(time_t t)
+{
+    sysTime = t;
+    sysTimeSet = millis();
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date and back
+static long daysFromCivil(int y, int m, int d)
+{
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void civilFromDays(long z, int &y, int &m, int &d)
+{
+    z += 719468;
+    long era = (z >= 0 ? z : z - 146096) / 146097;
+    long doe = z - era * 146097;
+    long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = yoe + era * 400 + (m <= 2);
+}
+
+int hour(time_t t) { return t % SECS_PER_DAY / SECS_PER_HOUR; }
+int minute(time_t t) { return t % SECS_PER_HOUR / SECS_PER_MIN; }
+int second(time_t t) { return t % SECS_PER_MIN; }
+int weekday(time_t t) { return (t / SECS_PER_DAY + 4) % 7 + 1; }
+
+int day(time_t t)
+{
+    int y, m, d;
+    civilFromDays(t / SECS_PER_DAY, y, m, d);
+    return d;
+}
+
+int month(time_t t)
+{
+    int y, m, d;
+    civilFromDays(t / SECS_PER_DAY, y, m, d);
+    return m;
+}
+
+int year(time_t t)
+{
+    int y, m, d;
+    civilFromDays(t / SECS_PER_DAY, y, m, d);
+    return y;
+}
+
+int hour() { return hour(now()); }
+int minute() { return minute(now()); }
+int second() { return second(now()); }
+int weekday() { return weekday(now()); }
+
+// Local time of the change in the given year, e.g. the last Sunday of March at 2:00
+time_t Timezone::toTime(const TimeChangeRule &rule, int y)
+{
+    int m = rule.month;
+    int week = rule.week;
+    if (week == Last)
+    {
+        // First such day of the next month, then a week back
+        if (++m > 12)
+        {
+            m = 1;
+            y++;
+        }
+        week = First;
+    }
+    time_t t = daysFromCivil(y, m, 1) * SECS_PER_DAY + rule.hour * SECS_PER_HOUR;
+    t += ((rule.dow - weekday(t) + 7) % 7 + (week - 1) * 7) * SECS_PER_DAY;
+    if (rule.week == Last)
+        t -= 7 * SECS_PER_DAY;
+    return t;
+}
+
+bool Timezone::utcIsDST(time_t utc)
+{
+    int y = year(utc);
+    time_t dstStart = toTime(dst, y) - std.offset * SECS_PER_MIN;
+    time_t stdStart = toTime(std, y) - dst.offset * SECS_PER_MIN;
+    if (dstStart < stdStart)
+        return utc >= dstStart && utc < stdStart;
+    return !(utc >= stdStart && utc < dstStart);
+}
+
+time_t Timezone::toLocal(time_t utc) { return utc + (utcIsDST(utc) ? dst.offset : std.offset) * SECS_PER_MIN; }
@@ -0,0 +1,95 @@
+#include <Arduino.h>
+
+namespace mock
+{
+unsigned long now = 0;
+void (*onTick)() = NULL;
+int digital[MOCK_PINS];
+int analog[MOCK_PINS];
+int pwm[MOCK_PINS];
+uint8_t mode[MOCK_PINS];
+
+static void (*interrupts[MOCK_PINS])();
+static int interruptModes[MOCK_PINS];
+static uint32_t rtcMemory[128];
+static unsigned long seed = 1;
+
+void advance(unsigned long ms)
+{
+    while (ms--)
+    {
+        now++;
+        if (onTick)
+            onTick();
+    }
+}
+
+void setDigital(uint8_t pin, int value)
+{
+    int old = digital[pin];
+    digital[pin] = value;
+    int edge = value && !old ? RISING : !value && old ? FALLING : 0;
+    if (edge && interrupts[pin] && (interruptModes[pin] & edge))
+        interrupts[pin]();
+}
+
+void reset()
+{
+    now = 0;
+    onTick = NULL;
+    memset(digital, 0, sizeof(digital));
+    memset(analog, 0, sizeof(analog));
+    memset(pwm, 0, sizeof(pwm));
+    memset(mode, 0, sizeof(mode));
+    memset(interrupts, 0, sizeof(interrupts));
+    memset(rtcMemory, 0, sizeof(rtcMemory));
+}
+} // namespace mock
+
+EspClass ESP;
+
+unsigned long millis() { return mock::now; }
+unsigned long micros() { return mock::now * 1000; }
+void delay(unsigned long ms) { mock::advance(ms); }
+void yield() {}
+void pinMode(uint8_t pin, uint8_t mode) { mock::mode[pin] = mode; }
+void digitalWrite(uint8_t pin, uint8_t value) { mock::digital[pin] = value; }
+int digitalRead(uint8_t pin) { return mock::digital[pin]; }
+void analogWrite(uint8_t pin, int value) { mock::pwm[pin] = value; }
+void analogWriteRange(uint32_t) {}
+void analogWriteResolution(int) {}
+int analogRead(uint8_t pin) { return mock::analog[pin]; }
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode)
+{
+    mock::interrupts[pin] = handler;
+    mock::interruptModes[pin] = mode;
+}
+
+void detachInterrupt(uint8_t pin) { mock::interrupts[pin] = NULL; }
+
+long random(long max)
+{
+    mock::seed = mock::seed * 1103515245 + 12345;
+    return max > 0 ? (long)((mock::seed >> 16) % max) : 0;
+}
+
+long random(long min, long max) { return min + random(max - min); }
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size)
+{
+    if (offset * 4 + size > sizeof(mock::rtcMemory))
+        return false;
+    memcpy(data, (uint8_t *)mock::rtcMemory + offset * 4, size);
+    return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size)
+{
+    if (offset * 4 + size > sizeof(mock::rtcMemory))
+        return false;
+    memcpy((uint8_t *)mock::rtcMemory + offset * 4, data, size);
+    return true;
+}
+
+bool EspClass::flashRead(uint32_t, uint32_t *, size_t) { return false; }
@@ -0,0 +1,30 @@
+#ifndef MOCKBOARD_H
+#define MOCKBOARD_H
+#include <Arduino.h>
+
+// Host board with resolutions that differ from the ESP8266 on both sides, so every rescale path is exercised.
+// Outputs and inputs are plain arrays indexed by pin.
+struct MockBoard
+{
+    typedef uint8_t Channel;
+    static const uint8_t PWM_BITS = 8;
+    static const uint8_t ADC_BITS = 12;
+
+    static Channel *duty()
+    {
+        static Channel values[MOCK_PINS];
+        return values;
+    }
+
+    static int *adc()
+    {
+        static int values[MOCK_PINS];
+        return values;
+    }
+
+    static void outputPin(uint8_t pin) { duty()[pin] = 0; }
+    static void writePwm(uint8_t pin, Channel value) { duty()[pin] = value; }
+    static int readAdc(uint8_t pin) { return adc()[pin]; }
+};
+
+#endif
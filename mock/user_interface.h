@@ -0,0 +1,19 @@
+#ifndef MOCK_USER_INTERFACE_H
+#define MOCK_USER_INTERFACE_H
+// The part of the NONOS SDK the firmware calls directly. The host never sleeps, so wake-up sources are no-ops.
+#include <stdint.h>
+
+typedef enum
+{
+    GPIO_PIN_INTR_DISABLE = 0,
+    GPIO_PIN_INTR_POSEDGE = 1,
+    GPIO_PIN_INTR_NEGEDGE = 2,
+    GPIO_PIN_INTR_ANYEDGE = 3,
+    GPIO_PIN_INTR_LOLEVEL = 4,
+    GPIO_PIN_INTR_HILEVEL = 5
+} GPIO_INT_TYPE;
+
+inline void wifi_enable_gpio_wakeup(uint32_t, GPIO_INT_TYPE) {}
+inline void wifi_disable_gpio_wakeup() {}
+
+#endif
@@ -3,6 +3,7 @@
 #include <ESP8266WebServer.h>
 #include <PubSubClient.h>
 #include <ArduinoOTA.h>
+#include <Updater.h>
 #include <NTPClient.h>
 #include <PIR.h>
 #include <Timezone.h>
@@ -11,6 +12,18 @@
 #include <TinyTemplateEngineMemoryReader.h>
 #include <WString.h>
 #include <ArduinoJson.h>
+extern "C"
+{
+#include <user_interface.h>
+}
+#include "board.hpp"
+#include "bootcache.hpp"
+#include "metrics.hpp"
+#include "peer.hpp"
+#include "peerudp.hpp"
+#include "occupancy.hpp"
+#include "trace.hpp"
+#include "delta.hpp"
 #include "RGBControl.hpp"
 #ifndef CI
 #include "credentials.h"
@@ -29,46 +42,115 @@ const char *ALARM_STATE_TOPIC = "";
 #include "alarm.hpp"
 #include "html.h"
 
-static const int CONFIG_VERSION = 1;
-static const uint8_t RED = D2;
-static const uint8_t GREEN = D5;
-static const uint8_t BLUE = D1;
+typedef Esp8266Board Board;
+
+static const int CONFIG_VERSION = 6;
+static const size_t NUM_ZONES = 2;
 static const short SPEED_DEFAULT = 3;
 static const short SPEED_FAST = 12;
 static const RGB COLOR_OFF = {0, 0, 0};
+// Measured per board; the green die of zone2 is noticeably stronger than its red and blue
+static const Calibration ZONE1_CALIBRATION = CALIBRATION_NONE;
+static const Calibration ZONE2_CALIBRATION = {{{1024, 0, 0}, {0, 850, 0}, {0, 0, 1000}}};
 const long dayFrom = 9 * 60 * 60;
 const long dayUntil = 20 * 60 * 60;
 const long nightFrom = 22 * 60 * 60;
 const long nightUntil = 8 * 60 * 60;
+// Fall back to a full scan and DHCP if the cached access point doesn't answer in time
+const unsigned long FAST_CONNECT_TIMEOUT = 10000;
+const unsigned long RTC_SAVE_INTERVAL = 60000;
+const unsigned long FLASH_TIME_SAVE_INTERVAL = 60 * 60000L;
+// Upper bound for one idle sleep, so OTA, the web server and MQTT keepalive are still served
+const unsigned long MAX_IDLE_SLEEP = 1000;
+const unsigned long IDLE_SLEEP_SLICE = 20;
+const unsigned long TELEMETRY_INTERVAL = 60000;
+const unsigned long ALARM_DURATION = 15 * 60000L;
+// How far ahead an alarm is announced to the other units, and the latest one we accept
+const unsigned long ALARM_ANNOUNCE_AHEAD = 2000;
+const unsigned long ALARM_ACCEPT_AHEAD = 10000;
+// Seconds between two clock reads beyond which the clock is taken to have been set, not to have run
+const time_t CLOCK_JUMP = 60;
+// Pre-lighting starts this many seconds before a usually occupied hour and waits this long into it
+const unsigned long PRE_LIGHT_LEAD = 5 * 60;
+const unsigned long PRE_LIGHT_WAIT = 10 * 60000L;
+// Trace topic ids, zone night light topics follow from TRACE_TOPIC_ZONE on
+const uint8_t TRACE_TOPIC_NIGHTLIGHT = 0;
+const uint8_t TRACE_TOPIC_ALARM_SET = 1;
+const uint8_t TRACE_TOPIC_ALARM_STATE = 2;
+const uint8_t TRACE_TOPIC_ZONE = 3;
+const uint8_t TRACE_TOPIC_OTHER = 255;
+const int TRACE_LIGHT_DEADBAND = 64;
 
 TimeChangeRule CEST = {"CEST", Last, Sun, Mar, 2, 120}; // Central European Summer Time
 TimeChangeRule CET = {"CET ", Last, Sun, Oct, 3, 60};   // Central European Standard Time
 Timezone CE(CEST, CET);
 
 void onMotionDetected(PirInfo *sender);
+void attachPirInterrupts();
+void handleDeltaUpload();
+void finishDeltaUpload();
 
 ESP8266WebServer server;
 WiFiClient wifiClient;
 PubSubClient client(wifiClient);
-PIR motion1 = PIR(D6, onMotionDetected, "motion1");
-PIR motion2 = PIR(D7, onMotionDetected, "motion2");
+PIR motion1 = PIR(Board::MOTION1, onMotionDetected, "motion1");
+PIR motion2 = PIR(Board::MOTION2, onMotionDetected, "motion2");
 WiFiUDP ntpUDP;
 NTPClient ntpClient(ntpUDP);
-AnalogRead lightSens(A0);
-RGBControl fader(RED, GREEN, BLUE);
+AnalogRead<Board> lightSens(Board::LIGHT_SENSOR);
+PeerLink<WiFiPeerUdp> peers(IPAddress(239, 255, 78, 76), 4210);
+PIR *const pirs[] = {&motion1, &motion2};
+static const uint8_t NUM_PIRS = sizeof(pirs) / sizeof(pirs[0]);
 
 unsigned long currentMillis;
-unsigned long switchToIdleTime = 0;
 String lastTopic("None");
 unsigned long lastLit;
+RtcCache rtcCache;
+bool fastConnect;
+bool ntpSynced;
+time_t restoredEpoch;
+
+volatile bool pirEdge;
+Metrics metrics;
+bool peerAlarmPending;
+unsigned long peerAlarmStart;
+unsigned long lastMotionEdge;
+bool motionThisHour;
+// 8kB of RAM, sized for a week: a busy day comes to roughly 100-150 records (two per PIR episode, a few
+// light band changes, NTP steps). Weeks with more motion keep correspondingly fewer days.
+TraceRecorder<1024> trace;
+
+// Milliseconds since boot, 0 until reached. lightsReady is the first pass through the sensors and zone
+// state machines, i.e. from then on motion turns a light on.
+struct BootTimings
+{
+  unsigned long lightsReady;
+  unsigned long wifi;
+  unsigned long mqtt;
+} bootTimings;
+
+// Motion in remoteZone of another unit pre-lights localZone of this one. Node 0 marks an unused entry.
+// Nodes are the low 16 bits of the chip id, see /status.json.
+struct Adjacency
+{
+  uint16_t node;
+  uint8_t remoteZone;
+  uint8_t localZone;
+};
+static const size_t MAX_ADJACENCY = 8;
 
 struct Config
 {
   short version = CONFIG_VERSION;
   RGB transitionColor = {1023, 1023, 1023};
-  RGB nightColor = {511, 0, 0};
+  RGB nightColor[NUM_ZONES] = {{511, 0, 0}, {511, 0, 0}};
   RGB alarmColor = {1023, 1023, 0};
   Alarm alarm[10];
+  WifiCache wifi = {};
+  uint32_t lastEpoch = 0;
+  // Saved along with lastEpoch, once an hour
+  OccupancyModel occupancy;
+  Adjacency adjacency[MAX_ADJACENCY] = {};
 } config;
 
 enum State
@@ -78,36 +160,108 @@ enum State
   TRANSITION_LIGHT,
   DARK_LIGHT,
   ALARM_PULSE_OFF,
-  ALARM_PULSE_ON
-} state;
+  ALARM_PULSE_ON,
+  PRE_LIGHT
+};
+
+static const char *stateNames[] = {"idle", "night", "transition", "dark", "alarm", "alarm", "prelight"};
+
+// A group of LEDs with its own state machine, lit by the PIRs in pirMask.
+struct Zone
+{
+  const char *name;
+  uint8_t pirMask;
+  RGBControl<Board> fader;
+  State state;
+  unsigned long switchToIdleTime;
+  bool motion;
+};
+
+Zone zones[NUM_ZONES] = {
+    {"zone1", 1 << 0, RGBControl<Board>(Board::RED, Board::GREEN, Board::BLUE, ZONE1_CALIBRATION), IDLE, 0},
+    {"zone2", 1 << 1, RGBControl<Board>(Board::RED2, Board::GREEN2, Board::BLUE2, ZONE2_CALIBRATION), IDLE, 0},
+};
 
 void saveConfig()
 {
   EEPROM.begin(sizeof(Config));
   EEPROM.put(0, config);
   EEPROM.end();
+  metrics.inc(METRIC_EEPROM_COMMITS);
 }
 
-void callback(char *topic, byte *payload, unsigned int length)
+String zoneTopic(const char *base, const Zone &z)
 {
-  if (!strcmp(topic, NIGHTLIGHT_TOPIC))
+  String topic(base);
+  topic += "/";
+  topic += z.name;
+  return topic;
+}
+
+// Accepts "r,g,b", "Hhue,sat,val" (hue in degrees) or "Kkelvin,val"; channels are 0..255
+RGB parseColor(byte *payload, unsigned int length)
+{
+  char c[15];
+  if (length >= sizeof(c))
+    length = sizeof(c) - 1;
+  memcpy(c, payload, length);
+  c[length] = '\0';
+  char *start = c;
+  if (c[0] == 'H' || c[0] == 'K')
+    start++;
+  int v[3] = {0, 0, 0};
+  char *tok = strtok(start, ",");
+  for (int i = 0; i < 3 && tok; i++)
   {
-    char c[15];
-    memcpy(c, payload, length);
-    c[length] = '\0';
-    char *tok = strtok(c, ",");
-    int red = atoi(tok);
+    v[i] = constrain(atoi(tok), 0, (i == 0 && c[0] == 'H') ? 359 : 255);
     tok = strtok(NULL, ",");
-    int green = atoi(tok);
-    tok = strtok(NULL, ",");
-    int blue = atoi(tok);
+  }
+  if (c[0] == 'H')
+    return hsvToRgb({v[0] * HUE_RANGE / 360, v[1] << 2, v[2] << 2});
+  if (c[0] == 'K')
+    return hsvToRgb(kelvinToHsv(atoi(start), v[1] << 2));
+  return {(uint16_t)(v[0] << 2), (uint16_t)(v[1] << 2), (uint16_t)(v[2] << 2)};
+}
 
-    config.nightColor.red = red << 2;
-    config.nightColor.green = green << 2;
-    config.nightColor.blue = blue << 2;
-    saveConfig();
+void setNightColor(Zone &z, int i, const RGB &color)
+{
+  config.nightColor[i] = color;
+  z.fader.fadeTo(color, 0);
+}
+
+bool publish(const char *topic, const char *payload, bool retained = false)
+{
+  bool sent = client.publish(topic, payload, retained);
+  metrics.inc(sent ? METRIC_MQTT_PUBLISHED : METRIC_MQTT_PUBLISH_FAILED);
+  return sent;
+}
 
-    fader.fadeTo(config.nightColor, 0);
+uint8_t traceTopicId(const char *topic)
+{
+  if (!strcmp(topic, NIGHTLIGHT_TOPIC))
+    return TRACE_TOPIC_NIGHTLIGHT;
+  if (!strcmp(topic, ALARM_SET_TOPIC))
+    return TRACE_TOPIC_ALARM_SET;
+  if (!strcmp(topic, ALARM_STATE_TOPIC))
+    return TRACE_TOPIC_ALARM_STATE;
+  for (size_t i = 0; i < NUM_ZONES; i++)
+  {
+    if (zoneTopic(NIGHTLIGHT_TOPIC, zones[i]) == topic)
+      return TRACE_TOPIC_ZONE + i;
+  }
+  return TRACE_TOPIC_OTHER;
+}
+
+void callback(char *topic, byte *payload, unsigned int length)
+{
+  metrics.inc(METRIC_MQTT_RECEIVED);
+  trace.recordMqtt(millis(), traceTopicId(topic), payload, length);
+  if (!strcmp(topic, NIGHTLIGHT_TOPIC))
+  {
+    RGB color = parseColor(payload, length);
+    for (size_t i = 0; i < NUM_ZONES; i++)
+      setNightColor(zones[i], i, color);
+    saveConfig();
   }
   else if (length > 6 && !strcmp(topic, ALARM_SET_TOPIC))
   {
@@ -126,12 +280,67 @@ void callback(char *topic, byte *payload, unsigned int length)
       a.enable();
     saveConfig();
   }
+  else
+  {
+    for (size_t i = 0; i < NUM_ZONES; i++)
+    {
+      if (zoneTopic(NIGHTLIGHT_TOPIC, zones[i]) == topic)
+      {
+        setNightColor(zones[i], i, parseColor(payload, length));
+        saveConfig();
+      }
+    }
+  }
   lastTopic = topic;
 }
 
+// The occupancy model is only read and taught with NTP time. A restored epoch is behind by however long
+// the power was off, it would put motion into the wrong hour.
+bool clockKnown()
+{
+  return ntpSynced;
+}
+
+uint8_t hourOfWeek()
+{
+  time_t time = now();
+  return (weekday(time) - 1) * 24 + hour(time);
+}
+
+unsigned long idleTimeout(unsigned long base)
+{
+  if (!clockKnown())
+    return base;
+  return config.occupancy.timeout(hourOfWeek(), base);
+}
+
+// Fade in quickly when someone is expected at this hour. Lighting ahead of them is preLightDue's job.
+short fadeInSpeed()
+{
+  if (clockKnown() && config.occupancy.expectsActivity(hourOfWeek()))
+    return SPEED_FAST;
+  return SPEED_DEFAULT;
+}
+
+// Shortly before an hour in which the room usually gets occupied again, e.g. the morning routine
+bool preLightDue()
+{
+  if (!clockKnown())
+    return false;
+  unsigned long intoHour = now() % 3600;
+  uint8_t next = (hourOfWeek() + 1) % HOURS_PER_WEEK;
+  return intoHour >= 3600 - PRE_LIGHT_LEAD && config.occupancy.startsActivity(next);
+}
+
+// Night color at half the duty, bright enough to find the way
+RGB preLightColor(const RGB &nightColor)
+{
+  return {(uint16_t)(nightColor.red >> 1), (uint16_t)(nightColor.green >> 1), (uint16_t)(nightColor.blue >> 1)};
+}
+
 void sendSensorData()
 {
-  StaticJsonDocument<300> doc;
+  StaticJsonDocument<512> doc;
   auto motionA = doc.createNestedObject();
   motionA["name"] = "Motion A";
   motionA["value"] = motion1.getState();
@@ -155,9 +364,12 @@ void sendSensorData()
   time += second();
   timeSens["value"] = time;
 
-  auto faderSens = doc.createNestedObject();
-  faderSens["name"] = "Fader";
-  faderSens["value"] = fader.toString();
+  for (Zone &z : zones)
+  {
+    auto faderSens = doc.createNestedObject();
+    faderSens["name"] = z.name;
+    faderSens["value"] = z.fader.toString();
+  }
 
   String out;
   serializeJson(doc, out);
@@ -166,7 +378,7 @@ void sendSensorData()
 
 void sendStatusData(short storedVersion)
 {
-  DynamicJsonDocument doc(2048);
+  DynamicJsonDocument doc(3072);
 
   auto mqtt = doc.createNestedObject();
   mqtt["name"] = "MQTT";
@@ -193,6 +405,67 @@ void sendStatusData(short storedVersion)
   ltr["name"] = "Last received topic";
   ltr["value"] = lastTopic;
 
+  const char *timingNames[] = {"Boot to lights ready", "Boot to WiFi", "Boot to MQTT"};
+  const unsigned long timings[] = {bootTimings.lightsReady, bootTimings.wifi, bootTimings.mqtt};
+  for (int i = 0; i < 3; i++)
+  {
+    auto timing = doc.createNestedObject();
+    timing["name"] = timingNames[i];
+    if (timings[i])
+      timing["value"] = String(timings[i]) + "ms";
+    else
+      timing["value"] = "Pending";
+  }
+
+  auto sleep = doc.createNestedObject();
+  sleep["name"] = "Time in sleep";
+  String sleepValue;
+  unsigned long sleepMillis = metrics.get(METRIC_SLEEP_MILLIS);
+  sleepValue += sleepMillis / 1000;
+  sleepValue += "s (";
+  sleepValue += (unsigned long)(sleepMillis * 100ULL / max(currentMillis, 1UL));
+  sleepValue += "%)";
+  sleep["value"] = sleepValue;
+
+  auto wake = doc.createNestedObject();
+  wake["name"] = "Wake-up latency";
+  String wakeValue;
+  wakeValue += metrics.get(METRIC_WAKE_LATENCY);
+  wakeValue += "ms, max ";
+  wakeValue += metrics.get(METRIC_WAKE_LATENCY_MAX);
+  wakeValue += "ms, ";
+  wakeValue += metrics.get(METRIC_WAKEUPS);
+  wakeValue += " wake-ups";
+  wake["value"] = wakeValue;
+
+  if (clockKnown())
+  {
+    uint8_t how = hourOfWeek();
+    auto occupancy = doc.createNestedObject();
+    occupancy["name"] = "Occupancy this hour";
+    String occupancyValue;
+    occupancyValue += config.occupancy.activity(how) * 100 / 255;
+    occupancyValue += "% active, ";
+    occupancyValue += config.occupancy.gap(how) / 1000;
+    occupancyValue += "s between movements, night light timeout ";
+    occupancyValue += idleTimeout(30000L) / 1000;
+    occupancyValue += "s";
+    occupancy["value"] = occupancyValue;
+  }
+
+  auto node = doc.createNestedObject();
+  node["name"] = "Node";
+  node["value"] = String(peers.getNode(), HEX);
+
+  auto clock = doc.createNestedObject();
+  clock["name"] = "Clock";
+  if (ntpSynced)
+    clock["value"] = "NTP";
+  else if (restoredEpoch)
+    clock["value"] = "Restored";
+  else
+    clock["value"] = "Unknown";
+
   auto llt = doc.createNestedObject();
   llt["name"] = "Room last lit";
   String lls;
@@ -205,19 +478,74 @@ void sendStatusData(short storedVersion)
   server.send(200, "text/html", out);
 }
 
-void setup()
+void sampleHeap()
+{
+  uint32_t freeHeap = ESP.getFreeHeap();
+  metrics.set(METRIC_UPTIME, currentMillis / 1000);
+  metrics.set(METRIC_HEAP_FREE, freeHeap);
+  if (!metrics.get(METRIC_HEAP_FREE_MIN) || freeHeap < metrics.get(METRIC_HEAP_FREE_MIN))
+    metrics.set(METRIC_HEAP_FREE_MIN, freeHeap);
+  metrics.set(METRIC_HEAP_MAX_BLOCK, ESP.getMaxFreeBlockSize());
+  metrics.set(METRIC_HEAP_FRAGMENTATION, ESP.getHeapFragmentation());
+}
+
+// Streamed metric by metric, so the response never sits in the heap it is measuring
+void sendMetrics()
+{
+  sampleHeap();
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/plain; version=0.0.4", "");
+  char buf[192];
+  for (int id = 0; id < METRIC_COUNT; id++)
+  {
+    size_t length = metrics.format((MetricId)id, buf, sizeof(buf));
+    server.sendContent(buf, length);
+  }
+  server.sendContent("");
+}
+
+void sendTrace()
+{
+  // The snapshot is the configuration the inputs act on: colors, alarms, learned model and peer wiring.
+  // The WiFi cache stays on the device.
+  Config snapshot = config;
+  snapshot.wifi = {};
+  TraceHeader header = trace.header(sizeof(snapshot));
+  server.setContentLength(sizeof(header) + header.snapshotSize + header.count * sizeof(TraceRecord));
+  server.send(200, "application/octet-stream", "");
+  server.sendContent((const char *)&header, sizeof(header));
+  server.sendContent((const char *)&snapshot, sizeof(snapshot));
+  trace.dump([](const uint8_t *data, size_t length) { server.sendContent((const char *)data, length); });
+}
+
+#ifdef NATIVE
+// Starts tools/replay from the snapshot of a downloaded trace
+bool restoreTraceSnapshot(const uint8_t *data, size_t size)
 {
-  state = IDLE;
+  Config snapshot;
+  if (size != sizeof(snapshot))
+    return false;
+  memcpy(&snapshot, data, size);
+  if (snapshot.version != CONFIG_VERSION)
+    return false;
+  snapshot.wifi = config.wifi;
+  config = snapshot;
+  return true;
+}
+#endif
 
+void route(const char *uri, ESP8266WebServer::THandlerFunction handler)
+{
+  server.on(uri, [handler] {
+    metrics.inc(METRIC_HTTP_REQUESTS);
+    handler();
+  });
+}
+
+void setup()
+{
   // put your setup code here, to run once:
   pinMode(LED_BUILTIN, OUTPUT);
-  pinMode(D1, OUTPUT);
-  pinMode(D2, OUTPUT);
-  pinMode(D5, OUTPUT);
-
-  analogWrite(BLUE, 0);
-  analogWrite(GREEN, 0);
-  analogWrite(RED, 0);
 
   EEPROM.begin(sizeof(Config));
   Config tmp = Config();
@@ -234,24 +562,47 @@ void setup()
     i++;
   }
 
+  // RTC memory holds the freshest state after a reset, flash the last one before a power loss
+  if (!rtcCache.load())
+  {
+    rtcCache.wifi = config.wifi;
+    rtcCache.epoch = config.lastEpoch;
+  }
+  restoredEpoch = rtcCache.epoch;
+
   ntpClient.setUpdateInterval(600000);
+  WiFi.persistent(false);
   WiFi.hostname("NightLight");
-  WiFi.begin(ssid, wifi_password);
+  fastConnect = rtcCache.wifi.isValid();
+  if (fastConnect)
+  {
+    const WifiCache &w = rtcCache.wifi;
+    WiFi.config(IPAddress(w.ip), IPAddress(w.gateway), IPAddress(w.subnet), IPAddress(w.dns));
+    WiFi.begin(ssid, wifi_password, w.channel, w.bssid);
+  }
+  else
+  {
+    WiFi.begin(ssid, wifi_password);
+  }
   WiFi.setAutoConnect(true);
   WiFi.setAutoReconnect(true);
 
+  attachPirInterrupts();
+
+  trace.record(millis(), TRACE_BOOT, 0, CONFIG_VERSION);
+
   ArduinoOTA.setPassword(ota_password);
   ArduinoOTA.begin();
 
-  server.on("/status.html", [] {
+  route("/status.html", [] {
     server.send(200, "text/html", FPSTR(status_html));
   });
 
-  server.on("/", [] {
+  route("/", [] {
     server.send(200, "text/html", FPSTR(index_html));
   });
 
-  server.on("/set", [] {
+  route("/set", [] {
     StaticJsonDocument<800> doc;
     deserializeJson(doc, server.arg("plain"));
     int i = 0;
@@ -270,8 +621,8 @@ void setup()
     server.send(200);
   });
 
-  server.on("/code.js", [] { server.send(200, "application/javascript", FPSTR(code_js)); });
-  server.on("/settings.json", [] {
+  route("/code.js", [] { server.send(200, "application/javascript", FPSTR(code_js)); });
+  route("/settings.json", [] {
     StaticJsonDocument<800> doc;
     for (Alarm &a : config.alarm)
     {
@@ -286,34 +637,133 @@ void setup()
 
     server.send(200, "application/json", out);
   });
-  server.on("/sensors.json", sendSensorData);
-  server.on("/status.json", [storedVersion] { sendStatusData(storedVersion); });
+  route("/adjacency/set", [] {
+    StaticJsonDocument<512> doc;
+    deserializeJson(doc, server.arg("plain"));
+    int i = 0;
+    for (Adjacency &a : config.adjacency)
+    {
+      const char *node = doc[i]["node"];
+      a.node = node ? strtoul(node, NULL, 16) : 0;
+      a.remoteZone = doc[i]["remoteZone"];
+      a.localZone = doc[i]["localZone"];
+      i++;
+    }
+    saveConfig();
+    server.send(200);
+  });
+  route("/adjacency.json", [] {
+    StaticJsonDocument<512> doc;
+    doc.to<JsonArray>();
+    for (const Adjacency &a : config.adjacency)
+    {
+      if (!a.node)
+        continue;
+      auto e = doc.createNestedObject();
+      e["node"] = String(a.node, HEX);
+      e["remoteZone"] = a.remoteZone;
+      e["localZone"] = a.localZone;
+    }
 
-  server.on("/toggle", [] {
+    String out;
+    serializeJson(doc, out);
+
+    server.send(200, "application/json", out);
+  });
+  route("/sensors.json", sendSensorData);
+  route("/status.json", [storedVersion] { sendStatusData(storedVersion); });
+  route("/metrics", sendMetrics);
+  route("/trace.bin", sendTrace);
+  server.on("/update", HTTP_POST, finishDeltaUpload, handleDeltaUpload);
+  route("/trace/clear", [] {
+    trace.clear();
+    server.send(200);
+  });
+
+  route("/toggle", [] {
     String out = "<html><body>";
     out += "triggering";
     out += "</body></html>";
     server.send(200, "text/html", out);
-    digitalWrite(D1, HIGH);
+    digitalWrite(Board::BLUE, HIGH);
     delay(500);
-    digitalWrite(D1, LOW);
+    digitalWrite(Board::BLUE, LOW);
   });
 
   server.begin();
   client.setServer(mqttServer, 1883);
+  // Telemetry messages don't fit the default 256 byte packet
+  client.setBufferSize(512);
   client.setCallback(callback);
 }
 
+ICACHE_RAM_ATTR void onPirEdge()
+{
+  pirEdge = true;
+}
+
+void attachPirInterrupts()
+{
+  attachInterrupt(digitalPinToInterrupt(Board::MOTION1), onPirEdge, RISING);
+  attachInterrupt(digitalPinToInterrupt(Board::MOTION2), onPirEdge, RISING);
+}
+
+// Interrupts alone don't wake the chip from light sleep, the SDK only wakes on GPIO levels. While
+// sleeping the PIR pins wake it when they go high, the edge interrupts are restored afterwards.
+void setPirWakeup(bool enable)
+{
+  if (enable)
+  {
+    wifi_enable_gpio_wakeup(Board::MOTION1, GPIO_PIN_INTR_HILEVEL);
+    wifi_enable_gpio_wakeup(Board::MOTION2, GPIO_PIN_INTR_HILEVEL);
+    return;
+  }
+  wifi_disable_gpio_wakeup();
+  attachPirInterrupts();
+}
+
+void learnMotion()
+{
+  if (!clockKnown())
+    return;
+  if (lastMotionEdge)
+    config.occupancy.onMotion(hourOfWeek(), currentMillis - lastMotionEdge);
+  lastMotionEdge = max(currentMillis, 1UL);
+  motionThisHour = true;
+}
+
+void trackOccupancyHour()
+{
+  static int lastHour = -1;
+  static time_t lastTime = 0;
+  if (!clockKnown())
+    return;
+  // An NTP correction or DST change is not the end of an hour we watched
+  time_t time = now();
+  if (lastTime && (time < lastTime || time - lastTime > CLOCK_JUMP))
+    lastHour = -1;
+  lastTime = time;
+  int current = hourOfWeek();
+  if (current == lastHour)
+    return;
+  if (lastHour >= 0)
+    config.occupancy.endHour(lastHour, motionThisHour);
+  motionThisHour = false;
+  lastHour = current;
+}
+
 void onMotionDetected(PirInfo *sender)
 {
+  if (sender->state)
+    learnMotion();
   if (!client.connected())
     return;
   String outTopic = String(BEDLIGHT_BASE_TOPIC) + sender->name;
 
   if (sender->state)
-    client.publish(outTopic.c_str(), "1");
+    publish(outTopic.c_str(), "1");
   else
-    client.publish(outTopic.c_str(), "0");
+    publish(outTopic.c_str(), "0");
 }
 
 void mqttConnect()
@@ -328,47 +778,134 @@ void mqttConnect()
     client.subscribe(NIGHTLIGHT_TOPIC);
     client.subscribe(ALARM_SET_TOPIC);
     client.subscribe(ALARM_STATE_TOPIC);
+    for (const Zone &z : zones)
+      client.subscribe(zoneTopic(NIGHTLIGHT_TOPIC, z).c_str());
+    if (!bootTimings.mqtt)
+      bootTimings.mqtt = currentMillis;
   }
 }
 
-void darkLight()
+void onWifiConnected()
 {
-  switchToIdleTime = currentMillis + 10000L;
-  state = DARK_LIGHT;
+  // Group membership doesn't survive a reconnect
+  peers.begin(WiFi.localIP(), ESP.getChipId());
+  if (bootTimings.wifi)
+    return;
+  bootTimings.wifi = currentMillis;
+  fastConnect = false;
+  WifiCache current = WifiCache::current();
+  if (current == rtcCache.wifi)
+    return;
+  rtcCache.wifi = current;
+  rtcCache.save();
+  config.wifi = current;
+  saveConfig();
 }
 
-void nightLight()
+void checkWifi()
 {
-  switchToIdleTime = currentMillis + 30000L;
-  state = NIGHT_LIGHT;
+  if (fastConnect && currentMillis > FAST_CONNECT_TIMEOUT)
+  {
+    // The cached access point or address is stale, scan and use DHCP
+    fastConnect = false;
+    WiFi.config(IPAddress(0u), IPAddress(0u), IPAddress(0u));
+    WiFi.begin(ssid, wifi_password);
+  }
+}
+
+time_t currentEpoch()
+{
+  if (ntpSynced)
+    return ntpClient.getEpochTime();
+  if (restoredEpoch)
+    return restoredEpoch + currentMillis / 1000;
+  return ntpClient.getEpochTime();
+}
+
+// UTC epoch in ms, the sub-second part counted from when the epoch second last changed
+uint64_t epochMillis()
+{
+  static time_t lastSecond = 0;
+  static unsigned long secondStart = 0;
+  time_t second = currentEpoch();
+  if (second != lastSecond)
+  {
+    lastSecond = second;
+    secondStart = currentMillis;
+  }
+  return (uint64_t)second * 1000 + min(currentMillis - secondStart, 999UL);
+}
+
+void persistTime(time_t epoch)
+{
+  static unsigned long lastRtcSave = 0;
+  static unsigned long lastFlashSave = 0;
+  // Before NTP or a restored epoch the clock is uptime, which must not end up in the cache as a date
+  if (!(ntpSynced || restoredEpoch) || currentMillis - lastRtcSave < RTC_SAVE_INTERVAL)
+    return;
+  lastRtcSave = currentMillis;
+  rtcCache.epoch = epoch;
+  rtcCache.save();
+  if (ntpSynced && (!lastFlashSave || currentMillis - lastFlashSave >= FLASH_TIME_SAVE_INTERVAL))
+  {
+    lastFlashSave = currentMillis;
+    config.lastEpoch = epoch;
+    saveConfig();
+  }
+}
+
+void publishZoneState(const Zone &z)
+{
+  if (!client.connected())
+    return;
+  String outTopic = String(BEDLIGHT_BASE_TOPIC) + z.name + "/state";
+  publish(outTopic.c_str(), stateNames[z.state], true);
 }
 
-void transitionLight()
+void darkLight(Zone &z)
 {
-  switchToIdleTime = currentMillis + 10000L;
-  state = TRANSITION_LIGHT;
+  z.switchToIdleTime = currentMillis + idleTimeout(10000L);
+  z.state = DARK_LIGHT;
 }
 
-void alarmState()
+void nightLight(Zone &z)
 {
-  switchToIdleTime = currentMillis + 1000L;
-  state = ALARM_PULSE_ON;
+  z.switchToIdleTime = currentMillis + idleTimeout(30000L);
+  z.state = NIGHT_LIGHT;
 }
 
-void onMotion()
+void transitionLight(Zone &z)
+{
+  z.switchToIdleTime = currentMillis + idleTimeout(10000L);
+  z.state = TRANSITION_LIGHT;
+}
+
+void preLight(Zone &z)
+{
+  z.switchToIdleTime = currentMillis + PRE_LIGHT_LEAD * 1000 + PRE_LIGHT_WAIT;
+  z.state = PRE_LIGHT;
+}
+
+void alarmState(Zone &z)
+{
+  z.switchToIdleTime = currentMillis + 1000L;
+  z.state = ALARM_PULSE_ON;
+}
+
+void onMotion(Zone &z)
 {
   long secsToday = elapsedSecsToday(now());
   if (secsToday < dayFrom || secsToday > dayUntil || currentMillis - lastLit < 1000)
   {
-    transitionLight();
+    transitionLight(z);
   }
   else if (secsToday > nightFrom || secsToday < nightUntil)
   {
-    nightLight();
+    nightLight(z);
   }
   else if (lightSens.getValue() < 20)
   {
-    darkLight();
+    darkLight(z);
   }
 }
 
@@ -381,9 +918,15 @@ bool checkForAlarm(bool stopAlarms)
       a.stop();
       a.loop();
     }
+    peerAlarmPending = false;
     return false;
   }
   bool alarmActive = false;
+  if (peerAlarmPending && (long)(currentMillis - peerAlarmStart) >= 0)
+  {
+    alarmActive = currentMillis - peerAlarmStart < ALARM_DURATION;
+    peerAlarmPending = alarmActive;
+  }
   for (Alarm &a : config.alarm)
   {
     a.loop();
@@ -392,87 +935,419 @@ bool checkForAlarm(bool stopAlarms)
   return alarmActive;
 }
 
-void loop()
+void updateZone(Zone &z, const RGB &nightColor, bool motionDetected, bool alarmActive, bool environmentIsLit, bool preLightNow)
 {
-  ArduinoOTA.handle();
-  currentMillis = millis();
-  if (WiFi.isConnected())
-  {
-    bool mqttConnected = client.loop();
-    if (!mqttConnected)
-      mqttConnect();
-    server.handleClient();
-    ntpClient.update();
-    digitalWrite(LED_BUILTIN, HIGH);
-  }
-  else
-  {
-    digitalWrite(LED_BUILTIN, LOW);
-  }
-  motion1.loop();
-  motion2.loop();
-  lightSens.loop();
-
-  // Update clock
-  time_t epochSecond = ntpClient.getEpochTime();
-  setTime(CE.toLocal(epochSecond));
-
-  bool motionDetected = motion1.getState() || motion2.getState();
-  bool alarmActive = checkForAlarm(motionDetected);
-  bool environmentIsLit = fader.isDark() && lightSens.getValue() > 30;
-  if (environmentIsLit)
-    lastLit = currentMillis;
+  State previousState = z.state;
+  if (currentMillis >= z.switchToIdleTime)
+    z.state = IDLE;
 
-  if (currentMillis >= switchToIdleTime)
-    state = IDLE;
-
-  switch (state)
+  switch (z.state)
   {
   case IDLE:
-    fader.fadeTo(COLOR_OFF, SPEED_DEFAULT);
+    z.fader.fadeTo(COLOR_OFF, SPEED_DEFAULT);
+    if (preLightNow && !environmentIsLit && lightSens.getValue() < 20)
+      preLight(z);
     if (motionDetected && !environmentIsLit)
-      onMotion();
+      onMotion(z);
     if (alarmActive)
-      alarmState();
+      alarmState(z);
+    break;
+  case PRE_LIGHT:
+    z.fader.fadeTo(preLightColor(nightColor), SPEED_DEFAULT);
+    if (motionDetected)
+      onMotion(z);
+    if (alarmActive)
+      alarmState(z);
     break;
   case NIGHT_LIGHT:
-    fader.fadeTo(config.nightColor, SPEED_DEFAULT);
+    z.fader.fadeTo(nightColor, fadeInSpeed());
     if (motionDetected)
-      onMotion();
+      onMotion(z);
     if (alarmActive)
-      alarmState();
+      alarmState(z);
     break;
   case TRANSITION_LIGHT:
-    fader.fadeTo(config.transitionColor, SPEED_FAST);
+    z.fader.fadeTo(config.transitionColor, SPEED_FAST);
     if (motionDetected)
-      onMotion();
+      onMotion(z);
     if (alarmActive)
-      alarmState();
+      alarmState(z);
     break;
   case DARK_LIGHT:
-    fader.fadeTo(config.transitionColor, SPEED_DEFAULT);
+    z.fader.fadeTo(config.transitionColor, fadeInSpeed());
     if (motionDetected)
-      darkLight();
+      darkLight(z);
     if (alarmActive)
-      alarmState();
+      alarmState(z);
     break;
   case ALARM_PULSE_OFF:
-    switchToIdleTime = currentMillis + 1000L;
-    fader.fadeTo(COLOR_OFF, SPEED_FAST);
-    if (fader.reachedTargetColor())
-      state = ALARM_PULSE_ON;
+    z.switchToIdleTime = currentMillis + 1000L;
+    z.fader.fadeTo(COLOR_OFF, SPEED_FAST);
+    if (z.fader.reachedTargetColor())
+      z.state = ALARM_PULSE_ON;
     if (!alarmActive)
-      state = IDLE;
+      z.state = IDLE;
     break;
   case ALARM_PULSE_ON:
-    switchToIdleTime = currentMillis + 1000L;
-    fader.fadeTo(config.alarmColor, SPEED_FAST);
-    if (fader.reachedTargetColor())
-      state = ALARM_PULSE_OFF;
+    z.switchToIdleTime = currentMillis + 1000L;
+    z.fader.fadeTo(config.alarmColor, SPEED_FAST);
+    if (z.fader.reachedTargetColor())
+      z.state = ALARM_PULSE_OFF;
     if (!alarmActive)
-      state = IDLE;
+      z.state = IDLE;
     break;
   }
 
-  fader.loop();
+  z.fader.loop();
+  uint8_t index = &z - zones;
+  if (strcmp(stateNames[z.state], stateNames[previousState]))
+  {
+    publishZoneState(z);
+    peers.send(PEER_STATE, index, z.state, epochMillis());
+  }
+  if (motionDetected != z.motion)
+  {
+    z.motion = motionDetected;
+    peers.send(PEER_MOTION, index, motionDetected, epochMillis());
+  }
+}
+
+// Tell the other units about an alarm shortly before it goes off, so they fire with us
+void announceAlarms()
+{
+  static uint64_t announced = 0;
+  time_t time = now();
+  for (const Alarm &a : config.alarm)
+  {
+    long seconds = a.secondsUntil(time);
+    if (seconds <= 0 || seconds * 1000 > (long)ALARM_ANNOUNCE_AHEAD)
+      continue;
+    uint64_t at = (currentEpoch() + seconds) * 1000ULL;
+    if (at == announced)
+      continue;
+    announced = at;
+    peers.send(PEER_ALARM, 0, 1, epochMillis(), at);
+  }
+}
+
+void handlePeers(bool environmentIsLit)
+{
+  PeerFrame frame;
+  uint64_t nowMillis = epochMillis();
+  while (peers.receive(frame, nowMillis))
+  {
+    int64_t at = (int64_t)frame.at - (int64_t)nowMillis;
+    trace.recordPeer(currentMillis, frame.type, frame.node, frame.zone, frame.value, frame.at != 0, constrain(at, (int64_t)INT32_MIN, (int64_t)INT32_MAX));
+    if (frame.type == PEER_MOTION && frame.value)
+    {
+      for (const Adjacency &a : config.adjacency)
+      {
+        if (!a.node || a.node != frame.node || a.remoteZone != frame.zone || a.localZone >= NUM_ZONES)
+          continue;
+        Zone &z = zones[a.localZone];
+        if (z.state == IDLE && !environmentIsLit)
+          onMotion(z);
+      }
+    }
+    else if (frame.type == PEER_ALARM)
+    {
+      int64_t lead = (int64_t)frame.at - (int64_t)nowMillis;
+      if (lead > -(int64_t)ALARM_DURATION && lead < (int64_t)ALARM_ACCEPT_AHEAD)
+      {
+        peerAlarmStart = currentMillis + (long)lead;
+        peerAlarmPending = true;
+      }
+    }
+  }
+}
+
+// Which side of the dark (< 20) and lit (> 30) thresholds a light reading is on
+uint8_t lightBand(int light)
+{
+  return light < 20 ? 0 : light <= 30 ? 1 : 2;
+}
+
+// Records what loop() is about to act on, whenever it changed
+void traceInputs(uint8_t motionMask, time_t epochSecond)
+{
+  static uint8_t lastMotionMask = 0;
+  static int lastLight = -1;
+  static long lastClockOffset = 0;
+  static TraceClock lastClockSource = TRACE_CLOCK_UPTIME;
+  if (motionMask != lastMotionMask)
+  {
+    lastMotionMask = motionMask;
+    trace.record(currentMillis, TRACE_PIR, motionMask);
+  }
+  // The ADC jitters by a few counts, only record steps and moves across the thresholds loop() acts on
+  int light = lightSens.getValue();
+  if (lastLight < 0 || abs(light - lastLight) >= TRACE_LIGHT_DEADBAND || lightBand(light) != lightBand(lastLight))
+  {
+    lastLight = light;
+    trace.record(currentMillis, TRACE_LIGHT, 0, light);
+  }
+  // The epoch only needs recording when the clock was set, in between it follows millis. NTP confirming
+  // a restored clock is recorded too, it switches on the learned timeouts.
+  long clockOffset = epochSecond - currentMillis / 1000;
+  TraceClock clockSource = ntpSynced ? TRACE_CLOCK_NTP : restoredEpoch ? TRACE_CLOCK_RESTORED : TRACE_CLOCK_UPTIME;
+  if (abs(clockOffset - lastClockOffset) > 1 || clockSource != lastClockSource)
+  {
+    lastClockOffset = clockOffset;
+    lastClockSource = clockSource;
+    trace.recordEpoch(currentMillis, epochSecond, clockSource);
+  }
+}
+
+bool canSleep(bool alarmActive)
+{
+  if (alarmActive || peerAlarmPending)
+    return false;
+  for (Zone &z : zones)
+  {
+    if (z.state != IDLE || !z.fader.reachedTargetColor() || !z.fader.isDark())
+      return false;
+  }
+  return true;
+}
+
+unsigned long sleepBudget()
+{
+  // Alarms only trigger in their exact second, never sleep across it
+  time_t time = now();
+  long untilAlarm = MAX_IDLE_SLEEP / 1000 + 2;
+  for (const Alarm &a : config.alarm)
+  {
+    long seconds = a.secondsUntil(time);
+    if (seconds >= 0)
+      untilAlarm = min(untilAlarm, seconds);
+  }
+  if (untilAlarm <= (long)(MAX_IDLE_SLEEP / 1000) + 1)
+    return 0;
+  return MAX_IDLE_SLEEP;
+}
+
+// With WIFI_LIGHT_SLEEP the SDK light-sleeps between DTIM beacons while we are in delay(),
+// keeping the association. A PIR going high wakes the chip and ends the sleep after the current slice.
+void idleSleep(bool alarmActive)
+{
+  static bool lightSleep = false;
+  unsigned long budget = canSleep(alarmActive) ? sleepBudget() : 0;
+  if (lightSleep != (budget > 0))
+  {
+    lightSleep = budget > 0;
+    WiFi.setSleepMode(lightSleep ? WIFI_LIGHT_SLEEP : WIFI_MODEM_SLEEP);
+    setPirWakeup(lightSleep);
+  }
+  if (!budget)
+  {
+    pirEdge = false;
+    return;
+  }
+
+  // A peer frame ends the sleep too, neighbours' motion and alarms are as urgent as our own
+  unsigned long start = millis();
+  unsigned long sliceStart = start;
+  while (!pirEdge && !peers.pending() && millis() - start < budget)
+  {
+    sliceStart = millis();
+    delay(IDLE_SLEEP_SLICE);
+  }
+  unsigned long end = millis();
+  metrics.inc(METRIC_SLEEP_MILLIS, end - start);
+  if (pirEdge)
+  {
+    // The ISR only runs once the chip is awake, so its time leaves out the wake-up. The edge came after
+    // the last check at the start of this slice, which bounds the latency including the sleep.
+    uint32_t latency = end - sliceStart;
+    metrics.inc(METRIC_WAKEUPS);
+    metrics.set(METRIC_WAKE_LATENCY, latency);
+    metrics.set(METRIC_WAKE_LATENCY_MAX, max(metrics.get(METRIC_WAKE_LATENCY_MAX), latency));
+    pirEdge = false;
+  }
+}
+
+void updateMetrics()
+{
+  static unsigned long nextSample = 0;
+  static unsigned long nextTelemetry = TELEMETRY_INTERVAL;
+  static uint32_t lastIterations = 0;
+  metrics.inc(METRIC_LOOP_ITERATIONS);
+  if (currentMillis < nextSample)
+    return;
+  nextSample = currentMillis + 1000;
+  uint32_t iterations = metrics.get(METRIC_LOOP_ITERATIONS);
+  metrics.set(METRIC_LOOP_RATE, iterations - lastIterations);
+  lastIterations = iterations;
+  sampleHeap();
+
+  if (currentMillis >= nextTelemetry && client.connected())
+  {
+    nextTelemetry = currentMillis + TELEMETRY_INTERVAL;
+    char buf[384];
+    metrics.formatTelemetry(buf, sizeof(buf));
+    String topic = String(BEDLIGHT_BASE_TOPIC) + "telemetry";
+    publish(topic.c_str(), buf);
+  }
+}
+
+// Sensors, clock and the zone state machines. Also runs while an update is received.
+bool lightLoop(bool networkUp)
+{
+  currentMillis = millis();
+  uint8_t motionMask = 0;
+  for (uint8_t i = 0; i < NUM_PIRS; i++)
+  {
+    pirs[i]->loop();
+    if (pirs[i]->getState())
+      motionMask |= 1 << i;
+  }
+  lightSens.loop();
+
+  // Update clock
+  time_t epochSecond = currentEpoch();
+  traceInputs(motionMask, epochSecond);
+  setTime(CE.toLocal(epochSecond));
+  persistTime(epochSecond);
+  trackOccupancyHour();
+
+  bool alarmActive = checkForAlarm(motionMask != 0);
+  bool lightsDark = true;
+  for (Zone &z : zones)
+    lightsDark &= z.fader.isDark();
+  bool environmentIsLit = lightsDark && lightSens.getValue() > 30;
+  if (environmentIsLit)
+    lastLit = currentMillis;
+
+  if (networkUp)
+  {
+    handlePeers(environmentIsLit);
+    announceAlarms();
+  }
+
+  bool preLightNow = preLightDue();
+  for (size_t i = 0; i < NUM_ZONES; i++)
+    updateZone(zones[i], config.nightColor[i], motionMask & zones[i].pirMask, alarmActive, environmentIsLit, preLightNow);
+  if (!bootTimings.lightsReady)
+    bootTimings.lightsReady = max(currentMillis, 1UL);
+
+  return alarmActive;
+}
+
+bool readRunningImage(uint32_t offset, uint32_t *buf, size_t length)
+{
+  // The running sketch starts at flash offset 0
+  return ESP.flashRead(offset, buf, length);
+}
+
+bool writeStagedImage(const uint8_t *buf, size_t length)
+{
+  return Update.write((uint8_t *)buf, length) == length;
+}
+
+String md5Hex(const uint8_t *md5)
+{
+  char hex[33];
+  for (int i = 0; i < 16; i++)
+    sprintf(hex + 2 * i, "%02x", md5[i]);
+  return String(hex);
+}
+
+bool acceptDelta(const DeltaHeader &header)
+{
+  if (header.oldSize != ESP.getSketchSize() || md5Hex(header.oldMd5) != ESP.getSketchMD5())
+    return false;
+  return Update.begin(header.newSize) && Update.setMD5(md5Hex(header.newMd5).c_str());
+}
+
+DeltaDecoder delta(readRunningImage, writeStagedImage, acceptDelta);
+const char *deltaError;
+// Only set by an authenticated upload that decoded completely and whose staged image verified
+bool deltaStaged;
+
+// Decodes the uploaded delta straight into the update partition. Update.end() checks
+// the MD5 of the staged image before the bootloader is pointed at it.
+void handleDeltaUpload()
+{
+  HTTPUpload &upload = server.upload();
+  switch (upload.status)
+  {
+  case UPLOAD_FILE_START:
+    deltaStaged = false;
+    deltaError = server.authenticate("nightlight", ota_password) ? nullptr : "Unauthorized";
+    delta.begin();
+    break;
+  case UPLOAD_FILE_WRITE:
+    if (!deltaError && !delta.write(upload.buf, upload.currentSize))
+      deltaError = delta.getError();
+    // The upload keeps loop() from running until it is complete
+    lightLoop(false);
+    break;
+  case UPLOAD_FILE_END:
+    if (!deltaError && !delta.done())
+      deltaError = "Delta incomplete";
+    if (!deltaError && !Update.end())
+      deltaError = "Staged image failed verification";
+    deltaStaged = !deltaError;
+    break;
+  case UPLOAD_FILE_ABORTED:
+    deltaError = "Upload aborted";
+    break;
+  }
+  // Drops a partially staged image
+  if (deltaError && upload.status != UPLOAD_FILE_WRITE)
+    Update.end();
+}
+
+void finishDeltaUpload()
+{
+  metrics.inc(METRIC_HTTP_REQUESTS);
+  // The upload handler only runs for a file part, so a POST without one must not see the last request's state
+  bool staged = deltaStaged;
+  const char *error = deltaError ? deltaError : "No update uploaded";
+  deltaStaged = false;
+  deltaError = nullptr;
+  if (staged)
+  {
+    server.send(200, "text/plain", "Update staged, restarting");
+    delay(100);
+    ESP.restart();
+  }
+  else if (!server.authenticate("nightlight", ota_password))
+  {
+    server.requestAuthentication();
+  }
+  else
+  {
+    server.send(400, "text/plain", error);
+  }
+}
+
+void loop()
+{
+  ArduinoOTA.handle();
+  currentMillis = millis();
+  static bool wifiConnected = false;
+  if (WiFi.isConnected())
+  {
+    if (!wifiConnected)
+      onWifiConnected();
+    wifiConnected = true;
+    bool mqttConnected = client.loop();
+    if (!mqttConnected)
+      mqttConnect();
+    server.handleClient();
+    if (ntpClient.update())
+      ntpSynced = true;
+    digitalWrite(LED_BUILTIN, HIGH);
+  }
+  else
+  {
+    wifiConnected = false;
+    checkWifi();
+    digitalWrite(LED_BUILTIN, LOW);
+  }
+
+  bool alarmActive = lightLoop(wifiConnected);
+  updateMetrics();
+  idleSleep(alarmActive);
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "mockboard.hpp"
+#include "RGBControl.hpp"
+#include "lightsensor.hpp"
+
+template <class Board>
+uint32_t written(uint8_t pin);
+
+template <>
+uint32_t written<MockBoard>(uint8_t pin) { return MockBoard::duty()[pin]; }
+template <>
+uint32_t written<Esp8266Board>(uint8_t pin) { return mock::pwm[pin]; }
+template <>
+uint32_t written<Esp8266Pwm16Board>(uint8_t pin) { return mock::pwm[pin]; }
+
+template <class Board>
+void setAdc(uint8_t pin, int value);
+
+template <>
+void setAdc<MockBoard>(uint8_t pin, int value) { MockBoard::adc()[pin] = value; }
+template <>
+void setAdc<Esp8266Board>(uint8_t pin, int value) { mock::analog[pin] = value; }
+template <>
+void setAdc<Esp8266Pwm16Board>(uint8_t pin, int value) { mock::analog[pin] = value; }
+
+void setUp() { mock::reset(); }
+void tearDown() {}
+
+void test_rescale()
+{
+    TEST_ASSERT_EQUAL(1023, (rescale<10, 10>(1023)));
+    TEST_ASSERT_EQUAL(255, (rescale<10, 8>(1023)));
+    TEST_ASSERT_EQUAL(65535, (rescale<10, 16>(1023)));
+    TEST_ASSERT_EQUAL(0, (rescale<10, 16>(0)));
+    TEST_ASSERT_EQUAL(1023, (rescale<12, 10>(4095)));
+}
+
+template <class Board>
+void fadeToFullScale()
+{
+    const uint32_t full = (1UL << Board::PWM_BITS) - 1;
+    RGBControl<Board> fader(D2, D5, D1);
+    TEST_ASSERT_EQUAL(0, written<Board>(D2));
+
+    fader.setFadePath(FADE_LINEAR);
+    fader.fadeTo(RGB{1023, 0, 1023}, 0);
+    fader.loop();
+    TEST_ASSERT_EQUAL(full, written<Board>(D2));
+    TEST_ASSERT_EQUAL(0, written<Board>(D5));
+    TEST_ASSERT_EQUAL(full, written<Board>(D1));
+    TEST_ASSERT_TRUE(fader.reachedTargetColor());
+    TEST_ASSERT_FALSE(fader.isDark());
+}
+
+template <class Board>
+void fadeStepsTowardsTarget()
+{
+    RGBControl<Board> fader(D2, D5, D1);
+    fader.fadeTo(RGB{0, 1023, 0}, 12);
+    for (int i = 0; i < 10; i++)
+    {
+        mock::advance(20);
+        fader.loop();
+    }
+    TEST_ASSERT_FALSE(fader.reachedTargetColor());
+    uint32_t halfway = written<Board>(D5);
+    TEST_ASSERT_TRUE(halfway > 0);
+    for (int i = 0; i < 1000 && !fader.reachedTargetColor(); i++)
+    {
+        mock::advance(20);
+        fader.loop();
+    }
+    TEST_ASSERT_TRUE(fader.reachedTargetColor());
+    TEST_ASSERT_TRUE(written<Board>(D5) > halfway);
+    TEST_ASSERT_EQUAL((1UL << Board::PWM_BITS) - 1, written<Board>(D5));
+}
+
+template <class Board>
+void sensorScalesToTenBits()
+{
+    AnalogRead<Board> sensor(A0);
+    setAdc<Board>(A0, (1 << Board::ADC_BITS) - 1);
+    mock::advance(1);
+    sensor.loop();
+    TEST_ASSERT_EQUAL(1023, sensor.getValue());
+    setAdc<Board>(A0, 0);
+    mock::advance(1000);
+    sensor.loop();
+    TEST_ASSERT_EQUAL(0, sensor.getValue());
+}
+
+void test_esp8266_fade() { fadeToFullScale<Esp8266Board>(); }
+void test_esp8266_steps() { fadeStepsTowardsTarget<Esp8266Board>(); }
+void test_esp8266_sensor() { sensorScalesToTenBits<Esp8266Board>(); }
+void test_pwm16_fade() { fadeToFullScale<Esp8266Pwm16Board>(); }
+void test_pwm16_steps() { fadeStepsTowardsTarget<Esp8266Pwm16Board>(); }
+void test_pwm16_sensor() { sensorScalesToTenBits<Esp8266Pwm16Board>(); }
+void test_mock_fade() { fadeToFullScale<MockBoard>(); }
+void test_mock_steps() { fadeStepsTowardsTarget<MockBoard>(); }
+void test_mock_sensor() { sensorScalesToTenBits<MockBoard>(); }
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rescale);
+    RUN_TEST(test_esp8266_fade);
+    RUN_TEST(test_esp8266_steps);
+    RUN_TEST(test_esp8266_sensor);
+    RUN_TEST(test_pwm16_fade);
+    RUN_TEST(test_pwm16_steps);
+    RUN_TEST(test_pwm16_sensor);
+    RUN_TEST(test_mock_fade);
+    RUN_TEST(test_mock_steps);
+    RUN_TEST(test_mock_sensor);
+    return UNITY_END();
+}
@@ -0,0 +1,236 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <vector>
+#include "delta.hpp"
+
+// tools/mkdelta.py output for the images built by makeOld() and makeNew(): a patched range, an insertion,
+// a deletion and an appended tail
+static const uint8_t FIXTURE[] = {
+    0x4e, 0x4c, 0x44, 0x31, 0xb8, 0x0b, 0x00, 0x00, 0x26, 0x0c, 0x00, 0x00, 0x97, 0x29, 0x91, 0xc0,
+    0x29, 0x61, 0xbe, 0x4a, 0xd3, 0x1b, 0x02, 0xd9, 0x9e, 0xa6, 0xf1, 0x3c, 0x56, 0x55, 0x22, 0x5a,
+    0x66, 0x50, 0x00, 0xc2, 0x6d, 0x3a, 0x3b, 0x87, 0x74, 0x9c, 0xd8, 0x12, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf4, 0x01, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00,
+    0x64, 0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0xf3, 0x93, 0xcb, 0x66, 0xca, 0x0a, 0xe3, 0x21, 0xc5,
+    0x73, 0x06, 0x9d, 0xd4, 0x8e, 0x19, 0x42, 0x27, 0xf9, 0xc6, 0xe1, 0x2e, 0xf2, 0x60, 0x5d, 0xd4,
+    0xe9, 0x79, 0x16, 0x7c, 0xcd, 0x45, 0x19, 0xbc, 0x13, 0xad, 0x08, 0xdc, 0x86, 0x33, 0xca, 0x0d,
+    0xd2, 0x88, 0xf3, 0x69, 0xce, 0xef, 0xf2, 0xaf, 0x8c, 0x4f, 0xfd, 0xba, 0x22, 0x1b, 0xbd, 0xc6,
+    0x37, 0xe2, 0xb9, 0x63, 0x4d, 0xb5, 0x83, 0x35, 0xd0, 0x3c, 0xa4, 0x71, 0xe2, 0x97, 0x47, 0x17,
+    0xe4, 0xf6, 0xa9, 0xef, 0xc4, 0xf7, 0x3c, 0x46, 0x09, 0xc3, 0x9e, 0x65, 0xa0, 0xe6, 0x3d, 0xd6,
+    0x64, 0xf2, 0xc6, 0x56, 0x6e, 0xd3, 0x52, 0x99, 0x22, 0xf1, 0x50, 0xc0, 0x58, 0x02, 0x00, 0x00,
+    0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0xff, 0x00, 0x57, 0x00, 0x07,
+    0x0e, 0x15, 0x1c, 0x23, 0x2a, 0x31, 0x38, 0x3f, 0x46, 0x4d, 0x54, 0x5b, 0x62, 0x69, 0x70, 0x77,
+    0x7e, 0x85, 0x8c, 0x93, 0x9a, 0xa1, 0xa8, 0xaf, 0xb6, 0xbd, 0xc4, 0xcb, 0xd2, 0xd9, 0xe0, 0xe7,
+    0xee, 0xf5, 0xfc, 0x03, 0x0a, 0x11, 0xf8, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1e, 0x00,
+    0x00, 0x00, 0x00, 0xff, 0x00, 0xff, 0x00, 0xf7, 0xf2, 0x03, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00, 0xf1, 0xa5, 0xa4, 0xa7, 0xa6,
+    0xa1, 0xa0, 0xa3, 0xa2, 0xad, 0xac, 0xaf, 0xae, 0xa9, 0xa8, 0xab, 0xaa, 0xb5, 0xb4, 0xb7, 0xb6,
+    0xb1, 0xb0, 0xb3, 0xb2, 0xbd, 0xbc, 0xbf, 0xbe, 0xb9, 0xb8, 0xbb, 0xba, 0x85, 0x84, 0x87, 0x86,
+    0x81, 0x80, 0x83, 0x82, 0x8d, 0x8c, 0x8f, 0x8e, 0x89, 0x88, 0x8b, 0x8a, 0x95, 0x94, 0x97, 0x96,
+    0x91, 0x90, 0x93, 0x92, 0x9d, 0x9c, 0x9f, 0x9e, 0x99, 0x98, 0x9b, 0x9a, 0xe5, 0xe4, 0xe7, 0xe6,
+    0xe1, 0xe0, 0xe3, 0xe2, 0xed, 0xec, 0xef, 0xee, 0xe9, 0xe8, 0xeb, 0xea, 0xf5, 0xf4, 0xf7, 0xf6,
+    0xf1, 0xf0, 0xf3, 0xf2, 0xfd, 0xfc, 0xff, 0xfe, 0xf9, 0xf8, 0xfb, 0xfa, 0xc5, 0xc4, 0xc7, 0xc6,
+};
+
+static std::vector<uint8_t> oldImage;
+static std::vector<uint8_t> newImage;
+static std::vector<uint8_t> written;
+
+static std::vector<uint8_t> makeOld()
+{
+    std::vector<uint8_t> image;
+    uint32_t x = 12345;
+    for (int i = 0; i < 3000; i++)
+    {
+        x = x * 1103515245 + 12345;
+        image.push_back(x >> 16);
+    }
+    return image;
+}
+
+static std::vector<uint8_t> makeNew(const std::vector<uint8_t> &old)
+{
+    std::vector<uint8_t> image(old);
+    for (int i = 500; i < 600; i++)
+        image[i] += 3;
+    std::vector<uint8_t> inserted;
+    for (int i = 0; i < 40; i++)
+        inserted.push_back(i * 7);
+    image.insert(image.begin() + 1200, inserted.begin(), inserted.end());
+    image.erase(image.begin() + 2000, image.begin() + 2030);
+    for (int i = 0; i < 100; i++)
+        image.push_back(0xa5 ^ i);
+    return image;
+}
+
+// Flash reads past the image return erased bytes, like the device
+static bool readOld(uint32_t offset, uint32_t *buf, size_t length)
+{
+    if (offset % 4 || length % 4)
+        return false;
+    for (size_t i = 0; i < length; i++)
+        ((uint8_t *)buf)[i] = offset + i < oldImage.size() ? oldImage[offset + i] : 0xff;
+    return true;
+}
+
+static bool writeNew(const uint8_t *buf, size_t length)
+{
+    written.insert(written.end(), buf, buf + length);
+    return true;
+}
+
+static bool acceptHeader(const DeltaHeader &header)
+{
+    return header.oldSize == oldImage.size() && header.newSize == newImage.size();
+}
+
+static bool feed(DeltaDecoder &decoder, const std::vector<uint8_t> &delta, size_t chunk)
+{
+    for (size_t i = 0; i < delta.size(); i += chunk)
+    {
+        if (!decoder.write(delta.data() + i, min(chunk, delta.size() - i)))
+            return false;
+    }
+    return true;
+}
+
+static std::vector<uint8_t> fixture() { return std::vector<uint8_t>(FIXTURE, FIXTURE + sizeof(FIXTURE)); }
+
+static void putU32(std::vector<uint8_t> &out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        out.push_back(value >> (8 * i));
+}
+
+// Header for the test images, followed by one hand made control block
+static std::vector<uint8_t> deltaWithBlock(uint32_t addLength, uint32_t extraLength, int32_t seek)
+{
+    std::vector<uint8_t> delta(FIXTURE, FIXTURE + DELTA_HEADER_SIZE);
+    putU32(delta, addLength);
+    putU32(delta, extraLength);
+    putU32(delta, seek);
+    return delta;
+}
+
+void setUp()
+{
+    oldImage = makeOld();
+    newImage = makeNew(oldImage);
+    written.clear();
+}
+
+void tearDown() {}
+
+static void roundTrip(size_t chunk)
+{
+    DeltaDecoder decoder(readOld, writeNew, acceptHeader);
+    TEST_ASSERT_TRUE(feed(decoder, fixture(), chunk));
+    TEST_ASSERT_NULL(decoder.getError());
+    TEST_ASSERT_TRUE(decoder.done());
+    TEST_ASSERT_EQUAL(newImage.size(), decoder.getProduced());
+    TEST_ASSERT_EQUAL(newImage.size(), written.size());
+    TEST_ASSERT_EQUAL_MEMORY(newImage.data(), written.data(), newImage.size());
+}
+
+void test_chunks_of_1() { roundTrip(1); }
+void test_chunks_of_7() { roundTrip(7); }
+void test_chunks_of_2048() { roundTrip(2048); }
+
+void test_truncated_delta_is_not_done()
+{
+    std::vector<uint8_t> delta = fixture();
+    delta.resize(delta.size() - 10);
+    DeltaDecoder decoder(readOld, writeNew, acceptHeader);
+    TEST_ASSERT_TRUE(feed(decoder, delta, 7));
+    TEST_ASSERT_FALSE(decoder.done());
+    TEST_ASSERT_TRUE(decoder.getProduced() < newImage.size());
+}
+
+void test_truncated_header_is_not_done()
+{
+    std::vector<uint8_t> delta = fixture();
+    delta.resize(DELTA_HEADER_SIZE - 1);
+    DeltaDecoder decoder(readOld, writeNew, acceptHeader);
+    TEST_ASSERT_TRUE(feed(decoder, delta, 2048));
+    TEST_ASSERT_FALSE(decoder.done());
+    TEST_ASSERT_EQUAL(0, decoder.getProduced());
+}
+
+void test_bad_magic()
+{
+    std::vector<uint8_t> delta = fixture();
+    delta[0] = 'X';
+    DeltaDecoder decoder(readOld, writeNew, acceptHeader);
+    TEST_ASSERT_FALSE(feed(decoder, delta, 7));
+    TEST_ASSERT_EQUAL_STRING("Not a delta", decoder.getError());
+    TEST_ASSERT_EQUAL(0, written.size());
+}
+
+void test_rejected_header()
+{
+    oldImage.push_back(0);
+    DeltaDecoder decoder(readOld, writeNew, acceptHeader);
+    TEST_ASSERT_FALSE(feed(decoder, fixture(), 2048));
+    TEST_ASSERT_EQUAL_STRING("Delta rejected", decoder.getError());
+}
+
+void test_block_past_end()
+{
+    DeltaDecoder decoder(readOld, writeNew, acceptHeader);
+    TEST_ASSERT_FALSE(feed(decoder, deltaWithBlock(newImage.size(), 1, 0), 1));
+    TEST_ASSERT_EQUAL_STRING("Block past end of image", decoder.getError());
+
+    // Both lengths near 2^32, their sum must not wrap
+    decoder.begin();
+    TEST_ASSERT_FALSE(feed(decoder, deltaWithBlock(0x80000000, 0x80000001, 0), 7));
+    TEST_ASSERT_EQUAL_STRING("Block past end of image", decoder.getError());
+}
+
+void test_zero_run_past_block()
+{
+    std::vector<uint8_t> delta = deltaWithBlock(4, 0, 0);
+    delta.push_back(0);
+    delta.push_back(4);
+    DeltaDecoder decoder(readOld, writeNew, acceptHeader);
+    TEST_ASSERT_FALSE(feed(decoder, delta, 1));
+    TEST_ASSERT_EQUAL_STRING("Zero run past block", decoder.getError());
+}
+
+void test_read_past_old_image()
+{
+    std::vector<uint8_t> delta = deltaWithBlock(2, 0, oldImage.size());
+    delta.insert(delta.end(), {0, 1});
+    putU32(delta, 1);
+    putU32(delta, 0);
+    putU32(delta, 0);
+    delta.push_back(1);
+    DeltaDecoder decoder(readOld, writeNew, acceptHeader);
+    TEST_ASSERT_FALSE(feed(decoder, delta, 7));
+    TEST_ASSERT_EQUAL_STRING("Read past old image", decoder.getError());
+}
+
+void test_data_after_end()
+{
+    std::vector<uint8_t> delta = fixture();
+    delta.push_back(0);
+    DeltaDecoder decoder(readOld, writeNew, acceptHeader);
+    TEST_ASSERT_FALSE(feed(decoder, delta, 2048));
+    TEST_ASSERT_EQUAL_STRING("Data after end of image", decoder.getError());
+    TEST_ASSERT_EQUAL_MEMORY(newImage.data(), written.data(), newImage.size());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_chunks_of_1);
+    RUN_TEST(test_chunks_of_7);
+    RUN_TEST(test_chunks_of_2048);
+    RUN_TEST(test_truncated_delta_is_not_done);
+    RUN_TEST(test_truncated_header_is_not_done);
+    RUN_TEST(test_bad_magic);
+    RUN_TEST(test_rejected_header);
+    RUN_TEST(test_block_past_end);
+    RUN_TEST(test_zero_run_past_block);
+    RUN_TEST(test_read_past_old_image);
+    RUN_TEST(test_data_after_end);
+    return UNITY_END();
+}
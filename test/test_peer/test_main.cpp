@@ -0,0 +1,196 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "peer.hpp"
+
+static const uint32_t GROUP = 0x4c4effef; // 239.255.78.76 in network byte order
+static const uint32_t LOOPBACK = 0x0100007f;
+static const uint16_t PORT = 42100;
+
+// PeerLink's Udp policy on a host socket. All nodes share the port and see each other through
+// multicast loopback on 127.0.0.1, like units sharing the WiFi network.
+class SocketUdp
+{
+public:
+    SocketUdp() : fd(-1) {}
+    ~SocketUdp()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool join(uint32_t local, uint32_t group, uint16_t port)
+    {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+#ifdef SO_REUSEPORT
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+#endif
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        ip_mreq membership = {};
+        membership.imr_multiaddr.s_addr = group;
+        membership.imr_interface.s_addr = local;
+        in_addr interface = {};
+        interface.s_addr = local;
+        unsigned char loop = 1;
+        return bind(fd, (sockaddr *)&address, sizeof(address)) == 0 &&
+               setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) == 0 &&
+               setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface)) == 0 &&
+               setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) == 0;
+    }
+
+    void send(uint32_t, uint32_t group, uint16_t port, const uint8_t *data, size_t size)
+    {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = group;
+        sendto(fd, data, size, 0, (sockaddr *)&address, sizeof(address));
+    }
+
+    bool pending()
+    {
+        uint8_t byte;
+        return recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) >= 0;
+    }
+
+    int receive(uint8_t *buf, size_t size)
+    {
+        ssize_t length = recv(fd, buf, size, MSG_DONTWAIT | MSG_TRUNC);
+        return length > 0 ? length : 0;
+    }
+
+private:
+    int fd;
+};
+
+typedef PeerLink<SocketUdp> Link;
+
+// Loopback delivery is asynchronous, give it a moment
+static bool waitPending(Link &link)
+{
+    for (int i = 0; i < 100; i++)
+    {
+        if (link.pending())
+            return true;
+        usleep(1000);
+    }
+    return false;
+}
+
+static bool receiveWithin(Link &link, PeerFrame &frame, uint64_t now)
+{
+    return waitPending(link) && link.receive(frame, now);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_frame_roundtrip()
+{
+    PeerFrame in = {PEER_ALARM, 0xbeef, 1, 7, 0x123456789abcULL, 0xfedcba987654ULL};
+    uint8_t buf[PEER_FRAME_SIZE];
+    TEST_ASSERT_EQUAL(PEER_FRAME_SIZE, encodePeerFrame(in, buf));
+    PeerFrame out;
+    TEST_ASSERT_TRUE(decodePeerFrame(buf, sizeof(buf), out));
+    TEST_ASSERT_EQUAL(in.type, out.type);
+    TEST_ASSERT_EQUAL(in.node, out.node);
+    TEST_ASSERT_EQUAL(in.zone, out.zone);
+    TEST_ASSERT_EQUAL(in.value, out.value);
+    TEST_ASSERT_TRUE(in.sentAt == out.sentAt);
+    TEST_ASSERT_TRUE(in.at == out.at);
+    buf[2]++;
+    TEST_ASSERT_FALSE(decodePeerFrame(buf, sizeof(buf), out));
+    TEST_ASSERT_FALSE(decodePeerFrame(buf, PEER_FRAME_SIZE - 1, out));
+}
+
+void test_motion_reaches_every_other_node()
+{
+    Link a(GROUP, PORT), b(GROUP, PORT), c(GROUP, PORT);
+    a.begin(LOOPBACK, 1);
+    b.begin(LOOPBACK, 2);
+    c.begin(LOOPBACK, 3);
+
+    a.send(PEER_MOTION, 1, 1, 1000);
+    PeerFrame frame;
+    TEST_ASSERT_TRUE(receiveWithin(b, frame, 1000));
+    TEST_ASSERT_EQUAL(PEER_MOTION, frame.type);
+    TEST_ASSERT_EQUAL(1, frame.node);
+    TEST_ASSERT_EQUAL(1, frame.zone);
+    TEST_ASSERT_EQUAL(1, frame.value);
+    TEST_ASSERT_TRUE(receiveWithin(c, frame, 1000));
+    TEST_ASSERT_EQUAL(1, frame.node);
+
+    // The sender hears its own frame through the loopback and drops it
+    TEST_ASSERT_TRUE(waitPending(a));
+    TEST_ASSERT_FALSE(a.receive(frame, 1000));
+    TEST_ASSERT_FALSE(b.receive(frame, 1000));
+}
+
+void test_pending_keeps_the_frame()
+{
+    Link a(GROUP, PORT), b(GROUP, PORT);
+    a.begin(LOOPBACK, 1);
+    b.begin(LOOPBACK, 2);
+
+    a.send(PEER_STATE, 0, 3, 1000);
+    TEST_ASSERT_TRUE(waitPending(b));
+    TEST_ASSERT_TRUE(b.pending());
+    PeerFrame frame;
+    TEST_ASSERT_TRUE(b.receive(frame, 1000));
+    TEST_ASSERT_EQUAL(PEER_STATE, frame.type);
+    TEST_ASSERT_EQUAL(3, frame.value);
+    TEST_ASSERT_FALSE(b.pending());
+}
+
+void test_alarm_time_follows_local_clock()
+{
+    Link a(GROUP, PORT), b(GROUP, PORT);
+    a.begin(LOOPBACK, 1);
+    b.begin(LOOPBACK, 2);
+
+    // b's clock runs 2 s behind a's
+    const uint64_t aNow = 1700000000000ULL;
+    const uint64_t bNow = aNow - 2000;
+    PeerFrame frame;
+    for (int i = 0; i < 3; i++)
+    {
+        a.send(PEER_ALARM, 0, 1, aNow, aNow + 5000);
+        TEST_ASSERT_TRUE(receiveWithin(b, frame, bNow));
+        TEST_ASSERT_TRUE(frame.at == bNow + 5000);
+    }
+}
+
+void test_foreign_datagrams_are_skipped()
+{
+    Link a(GROUP, PORT), b(GROUP, PORT);
+    a.begin(LOOPBACK, 1);
+    b.begin(LOOPBACK, 2);
+
+    SocketUdp other;
+    TEST_ASSERT_TRUE(other.join(LOOPBACK, GROUP, PORT));
+    const uint8_t noise[] = "not a nightlight frame";
+    other.send(LOOPBACK, GROUP, PORT, noise, sizeof(noise));
+    a.send(PEER_MOTION, 0, 1, 1000);
+    PeerFrame frame;
+    TEST_ASSERT_TRUE(receiveWithin(b, frame, 1000));
+    TEST_ASSERT_EQUAL(PEER_MOTION, frame.type);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_frame_roundtrip);
+    RUN_TEST(test_motion_reaches_every_other_node);
+    RUN_TEST(test_pending_keeps_the_frame);
+    RUN_TEST(test_alarm_time_follows_local_clock);
+    RUN_TEST(test_foreign_datagrams_are_skipped);
+    return UNITY_END();
+}
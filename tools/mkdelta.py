@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Builds a firmware delta for the /update endpoint, see include/delta.hpp for the format.
+
+    tools/mkdelta.py old.bin new.bin delta.bin
+    curl -u nightlight:<ota password> -F image=@delta.bin http://<node>/update
+
+old.bin must be exactly the image running on the node, the node rejects the delta otherwise.
+"""
+import argparse
+import hashlib
+import struct
+import sys
+
+KEY = 8
+MAX_CANDIDATES = 8
+# Give up extending a match once it is this many mismatches behind its best point
+SLACK = 16
+
+
+def index_old(old):
+    index = {}
+    for i in range(len(old) - KEY + 1):
+        positions = index.setdefault(old[i:i + KEY], [])
+        if len(positions) < MAX_CANDIDATES:
+            positions.append(i)
+    return index
+
+
+def extend(old, new, o, n):
+    """Length of the approximate match of new[n:] against old[o:]."""
+    score = best_score = best_length = 0
+    length = 0
+    while o + length < len(old) and n + length < len(new):
+        score += 1 if old[o + length] == new[n + length] else -1
+        length += 1
+        if score > best_score:
+            best_score, best_length = score, length
+        elif score < best_score - SLACK:
+            break
+    return best_length
+
+
+def find_matches(old, new):
+    index = index_old(old)
+    matches = []
+    n = 0
+    while n + KEY <= len(new):
+        best = (0, 0)
+        for o in index.get(new[n:n + KEY], ()):
+            length = extend(old, new, o, n)
+            if length > best[1]:
+                best = (o, length)
+        if best[1] >= KEY:
+            matches.append((n, best[0], best[1]))
+            n += best[1]
+        else:
+            n += 1
+    return matches
+
+
+def encode_add(old, new, o, n, length):
+    out = bytearray()
+    i = 0
+    while i < length:
+        diff = (new[n + i] - old[o + i]) & 0xff
+        if diff:
+            out.append(diff)
+            i += 1
+            continue
+        run = 1
+        while run < 256 and i + run < length and new[n + i + run] == old[o + i + run]:
+            run += 1
+        out += bytes((0, run - 1))
+        i += run
+    return out
+
+
+def encode(old, new):
+    out = bytearray(b'NLD1')
+    out += struct.pack('<II', len(old), len(new))
+    out += hashlib.md5(old).digest() + hashlib.md5(new).digest()
+
+    matches = find_matches(old, new)
+    # A leading block with nothing to add carries the bytes before the first match
+    blocks = [(0, 0, 0)] + matches
+    for i, (n, o, length) in enumerate(blocks):
+        if i + 1 < len(blocks):
+            next_n, next_o = blocks[i + 1][:2]
+        else:
+            next_n, next_o = len(new), o + length
+        out += struct.pack('<IIi', length, next_n - n - length, next_o - (o + length))
+        out += encode_add(old, new, o, n, length)
+        out += new[n + length:next_n]
+    return bytes(out)
+
+
+def decode(old, delta):
+    """Reference decoder, mirrors DeltaDecoder."""
+    assert delta[:4] == b'NLD1'
+    old_size, new_size = struct.unpack_from('<II', delta, 4)
+    assert old_size == len(old) and delta[12:28] == hashlib.md5(old).digest()
+    new = bytearray()
+    pos = 44
+    old_pos = 0
+    while len(new) < new_size:
+        add, extra, seek = struct.unpack_from('<IIi', delta, pos)
+        pos += 12
+        end = len(new) + add
+        while len(new) < end:
+            b = delta[pos]
+            pos += 1
+            if b:
+                new.append((old[old_pos] + b) & 0xff)
+                old_pos += 1
+            else:
+                for _ in range(delta[pos] + 1):
+                    new.append(old[old_pos])
+                    old_pos += 1
+                pos += 1
+        new += delta[pos:pos + extra]
+        pos += extra
+        old_pos += seek
+    assert pos == len(delta) and hashlib.md5(new).digest() == delta[28:44]
+    return bytes(new)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('old')
+    parser.add_argument('new')
+    parser.add_argument('delta')
+    args = parser.parse_args()
+    with open(args.old, 'rb') as f:
+        old = f.read()
+    with open(args.new, 'rb') as f:
+        new = f.read()
+    delta = encode(old, new)
+    if decode(old, delta) != new:
+        sys.exit('Round trip failed')
+    with open(args.delta, 'wb') as f:
+        f.write(delta)
+    print('%d bytes, %.1f%% of the full image' % (len(delta), 100.0 * len(delta) / len(new)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,295 @@
+// Runs a trace downloaded from /trace.bin through the real setup()/loop() on the host and prints every
+// change of the zone outputs. Diffing that output between two builds shows what a change does to the light:
+//
+//   pio run -e replay && .pio/build/replay/program trace.bin > before.txt
+//   ... change the firmware ...
+//   pio run -e replay && .pio/build/replay/program -c before.txt trace.bin
+//
+// Inputs reach the firmware the way the hardware delivers them: PIR pins and their interrupt, the ADC,
+// NTP, MQTT messages from client.loop() and peer frames on the multicast socket. Time only advances
+// in loop() steps and in the firmware's own delay() calls, so a day of trace replays in seconds.
+// Reboots inside the trace are replayed as continuous time.
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include <NTPClient.h>
+#include <PIR.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "board.hpp"
+#include "peer.hpp"
+#include "trace.hpp"
+
+void setup();
+void loop();
+bool restoreTraceSnapshot(const uint8_t *data, size_t size);
+
+struct Event
+{
+    unsigned long at;
+    TraceRecord record;
+};
+
+struct Replay
+{
+    std::vector<Event> events;
+    size_t next = 0;
+    size_t applied = 0;
+
+    // Multi-record groups, assembled until complete
+    bool haveEpoch = false;
+    uint8_t epochSource = 0;
+    uint16_t epochHigh = 0;
+    bool haveMqtt = false;
+    uint8_t mqttTopic = 0;
+    size_t mqttLength = 0;
+    std::string mqttPayload;
+    int peerRecords = 0;
+    PeerFrame peer = {};
+};
+
+static Replay replay;
+static WiFiUDP ntpUdp;
+static NTPClient ntp(ntpUdp);
+
+static uint64_t epochMillis() { return (uint64_t)ntp.getEpochTime() * 1000; }
+
+static void sendPeer(int64_t at)
+{
+    uint8_t buf[PEER_FRAME_SIZE];
+    replay.peer.sentAt = epochMillis();
+    replay.peer.at = at ? replay.peer.sentAt + at : 0;
+    mock::receiveUdp(buf, encodePeerFrame(replay.peer, buf));
+    replay.peerRecords = 0;
+}
+
+static void deliverMqtt()
+{
+    replay.haveMqtt = false;
+    std::vector<std::string> &topics = mock::subscriptions();
+    if (replay.mqttTopic >= topics.size())
+    {
+        fprintf(stderr, "%lu: MQTT message for unknown topic %u dropped\n", mock::now, replay.mqttTopic);
+        return;
+    }
+    mock::receiveMqtt(topics[replay.mqttTopic], replay.mqttPayload);
+}
+
+static void apply(const TraceRecord &r)
+{
+    replay.applied++;
+    switch (r.kind)
+    {
+    case TRACE_PIR:
+        for (size_t i = 0; i < mock::pirPins().size(); i++)
+            mock::setDigital(mock::pirPins()[i], r.arg >> i & 1);
+        break;
+    case TRACE_LIGHT:
+        mock::analog[Esp8266Board::LIGHT_SENSOR] = r.value;
+        break;
+    case TRACE_EPOCH_HIGH:
+        replay.haveEpoch = true;
+        replay.epochSource = r.arg;
+        replay.epochHigh = r.value;
+        break;
+    case TRACE_EPOCH_LOW:
+        // Only an NTP epoch makes the firmware trust the clock, a restored one is just set
+        if (replay.haveEpoch)
+            mock::setEpoch((unsigned long)replay.epochHigh << 16 | r.value, replay.epochSource == TRACE_CLOCK_NTP);
+        replay.haveEpoch = false;
+        break;
+    case TRACE_MQTT:
+        replay.haveMqtt = true;
+        replay.mqttTopic = r.arg;
+        replay.mqttLength = r.value;
+        replay.mqttPayload.clear();
+        if (!replay.mqttLength)
+            deliverMqtt();
+        break;
+    case TRACE_MQTT_DATA:
+        if (!replay.haveMqtt)
+            break;
+        replay.mqttPayload += (char)r.arg;
+        replay.mqttPayload += (char)(r.value & 0xff);
+        replay.mqttPayload += (char)(r.value >> 8);
+        if (replay.mqttPayload.size() >= replay.mqttLength)
+        {
+            replay.mqttPayload.resize(replay.mqttLength);
+            deliverMqtt();
+        }
+        break;
+    case TRACE_PEER:
+        replay.peerRecords = 1;
+        replay.peer.type = r.arg;
+        replay.peer.node = r.value;
+        break;
+    case TRACE_PEER_DATA:
+        if (replay.peerRecords != 1)
+            break;
+        replay.peerRecords = 2;
+        replay.peer.zone = r.arg;
+        replay.peer.value = r.value;
+        // Only timed frames carry a TRACE_PEER_AT
+        if (replay.peer.type != PEER_ALARM)
+            sendPeer(0);
+        break;
+    case TRACE_PEER_AT:
+        if (replay.peerRecords == 2)
+            sendPeer((int16_t)r.value * 100LL);
+        break;
+    default:
+        break;
+    }
+}
+
+static void applyDue()
+{
+    while (replay.next < replay.events.size() && replay.events[replay.next].at <= mock::now)
+        apply(replay.events[replay.next++].record);
+}
+
+static bool load(const char *path, std::vector<uint8_t> &snapshot)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    TraceHeader header;
+    if (data.size() < sizeof(header))
+    {
+        fprintf(stderr, "%s: not a trace\n", path);
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, "NLTR", 4) || header.version != TRACE_VERSION || header.recordSize != sizeof(TraceRecord) ||
+        data.size() < sizeof(header) + header.snapshotSize + header.count * sizeof(TraceRecord))
+    {
+        fprintf(stderr, "%s: not a version %u trace\n", path, TRACE_VERSION);
+        return false;
+    }
+    const uint8_t *p = data.data() + sizeof(header);
+    snapshot.assign(p, p + header.snapshotSize);
+    p += header.snapshotSize;
+
+    // Device millis restart at every boot, the replay timeline keeps running
+    unsigned long offset = 0;
+    uint32_t last = 0;
+    for (int i = 0; i < header.count; i++, p += sizeof(TraceRecord))
+    {
+        Event e;
+        memcpy(&e.record, p, sizeof(TraceRecord));
+        if (e.record.millis < last)
+            offset += last - e.record.millis;
+        last = e.record.millis;
+        e.at = e.record.millis + offset;
+        replay.events.push_back(e);
+    }
+    return true;
+}
+
+static bool readLines(const char *path, std::vector<std::string> &lines)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    std::string line;
+    while (std::getline(in, line))
+        lines.push_back(line);
+    return true;
+}
+
+static int usage()
+{
+    fprintf(stderr, "usage: replay [-c expected.txt] [-t tail seconds] trace.bin\n");
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    const char *expectedPath = NULL;
+    const char *tracePath = NULL;
+    unsigned long tail = 15 * 60;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-c") && i + 1 < argc)
+            expectedPath = argv[++i];
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            tail = strtoul(argv[++i], NULL, 10);
+        else if (argv[i][0] != '-' && !tracePath)
+            tracePath = argv[i];
+        else
+            return usage();
+    }
+    std::vector<uint8_t> snapshot;
+    if (!tracePath || !load(tracePath, snapshot))
+        return usage();
+    if (replay.events.empty())
+    {
+        fprintf(stderr, "%s: no records\n", tracePath);
+        return 1;
+    }
+
+    mock::now = replay.events.front().at;
+    unsigned long start = mock::now;
+    unsigned long end = replay.events.back().at + tail * 1000;
+    setup();
+    if (!restoreTraceSnapshot(snapshot.data(), snapshot.size()))
+        fprintf(stderr, "snapshot of %u bytes doesn't match this build, starting from defaults\n", (unsigned)snapshot.size());
+    mock::onTick = applyDue;
+
+    const uint8_t pins[][3] = {{Esp8266Board::RED, Esp8266Board::GREEN, Esp8266Board::BLUE},
+                               {Esp8266Board::RED2, Esp8266Board::GREEN2, Esp8266Board::BLUE2}};
+    const size_t zones = sizeof(pins) / sizeof(pins[0]);
+    int outputs[zones][3];
+    memset(outputs, -1, sizeof(outputs));
+    std::vector<std::string> lines;
+    while (mock::now < end)
+    {
+        applyDue();
+        loop();
+        for (size_t z = 0; z < zones; z++)
+        {
+            int *o = outputs[z];
+            const uint8_t *p = pins[z];
+            if (o[0] == mock::pwm[p[0]] && o[1] == mock::pwm[p[1]] && o[2] == mock::pwm[p[2]])
+                continue;
+            for (int c = 0; c < 3; c++)
+                o[c] = mock::pwm[p[c]];
+            char line[64];
+            snprintf(line, sizeof(line), "%lu zone%u %d %d %d", mock::now - start, (unsigned)z + 1, o[0], o[1], o[2]);
+            lines.push_back(line);
+        }
+        mock::advance(1);
+    }
+    fprintf(stderr, "replayed %u of %u records over %lu s, %u output changes\n", (unsigned)replay.applied,
+            (unsigned)replay.events.size(), (end - start) / 1000, (unsigned)lines.size());
+
+    if (!expectedPath)
+    {
+        for (const std::string &line : lines)
+            puts(line.c_str());
+        return 0;
+    }
+    std::vector<std::string> expected;
+    if (!readLines(expectedPath, expected))
+    {
+        fprintf(stderr, "%s: can't read\n", expectedPath);
+        return 2;
+    }
+    size_t differing = 0;
+    size_t first = 0;
+    for (size_t i = 0; i < max(lines.size(), expected.size()); i++)
+    {
+        if (i < lines.size() && i < expected.size() && lines[i] == expected[i])
+            continue;
+        if (!differing++)
+            first = i;
+    }
+    if (!differing)
+    {
+        fprintf(stderr, "outputs match %s\n", expectedPath);
+        return 0;
+    }
+    fprintf(stderr, "%u of %u output lines differ, first at line %u:\n  expected: %s\n  actual:   %s\n", (unsigned)differing,
+            (unsigned)max(lines.size(), expected.size()), (unsigned)first + 1,
+            first < expected.size() ? expected[first].c_str() : "(end)", first < lines.size() ? lines[first].c_str() : "(end)");
+    return 1;
+}